@@ -0,0 +1,202 @@
+// Measures the crossover points of the algorithms the library dispatches between on this host & writes them as a
+// config for LoadDispatchThresholds (see DispatchThresholds)
+// * Point INTERVALS_TUNING at the written file & the library picks it up on first use
+// * Build with e.g: g++ -std=c++20 -O2 -mavx2 -pthread autotune.cxx -o autotune
+//
+// Usage: autotune [config path, default intervals.tune]
+
+#include "intervals.cxx"
+
+#include <cstdio>
+#include <random>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::vector<Interval> RandomIntervals(std::mt19937_64 &random, size_t count, long int range, long int length) {
+    std::vector<Interval> intervals;
+    intervals.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const long int min = static_cast<long int>(random() % static_cast<unsigned long>(range));
+        intervals.emplace_back(min, min + static_cast<long int>(random() % static_cast<unsigned long>(length)));
+    }
+    return intervals;
+}
+
+// Best of a few trials of running work, in seconds - the best one is the least disturbed by the rest of the machine
+template <typename Work>
+double Measure(Work work) {
+    double best = std::numeric_limits<double>::max();
+    for (int trial = 0; trial < 5; ++trial) {
+        const Clock::time_point start = Clock::now();
+        work();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+// Sorts copies of inputs with sort, copying is timed too but costs both sides of a comparison the same
+template <typename Sort>
+double MeasureSort(const std::vector<std::vector<Interval>> &inputs, Sort sort) {
+    std::vector<Interval> scratch;
+    return Measure([&]() {
+        for (const std::vector<Interval> &input : inputs) {
+            scratch = input;
+            sort(scratch);
+        }
+    });
+}
+
+// Largest n the sorting network still beats std::sort at, scanning up until it loses twice in a row
+size_t TuneSortingNetwork(std::mt19937_64 &random) {
+    size_t threshold = 1;
+    size_t losses = 0;
+
+    for (size_t count = 2; count <= 64 && losses < 2; ++count) {
+        std::vector<std::vector<Interval>> inputs;
+        for (size_t i = 0; i < 20000 / count + 100; ++i) {
+            inputs.push_back(RandomIntervals(random, count, 1000000, 100));
+        }
+
+        const double network = MeasureSort(inputs, [](std::vector<Interval> &v) { NetworkSortIntervals(v); });
+        const double standard = MeasureSort(inputs, [](std::vector<Interval> &v) { std::sort(v.begin(), v.end()); });
+
+        if (network < standard) {
+            threshold = count;
+            losses = 0;
+        }
+        else {
+            ++losses;
+        }
+    }
+
+    return threshold;
+}
+
+// Smallest n (a power of 2) from which radix sort beats std::sort at two sizes in a row, so a single noisy
+// measurement doesn't settle it
+size_t TuneRadixSort(std::mt19937_64 &random) {
+    bool wonPrevious = false;
+
+    for (size_t count = 256; count <= (size_t(1) << 20); count *= 2) {
+        std::vector<std::vector<Interval>> inputs;
+        for (size_t i = 0; i < std::max<size_t>((size_t(1) << 20) / count, 1); ++i) {
+            inputs.push_back(RandomIntervals(random, count, std::numeric_limits<long int>::max() / 2, 1000));
+        }
+
+        const double radix = MeasureSort(inputs, [](std::vector<Interval> &v) { RadixSortIntervals(v); });
+        const double standard = MeasureSort(inputs, [](std::vector<Interval> &v) { std::sort(v.begin(), v.end()); });
+
+        const bool won = radix < standard;
+        if (won && wonPrevious) {
+            return count / 2;
+        }
+        wonPrevious = won;
+    }
+
+    return wonPrevious ? (size_t(1) << 20) : std::numeric_limits<size_t>::max();
+}
+
+// Smallest collection (a power of 2) from which clipping to the target beats sorting the whole collection, with targets
+// spanning ~1% of the domain
+size_t TuneClipScan(std::mt19937_64 &random) {
+    const long int range = 1000000;
+    SlowQueryLog::Timer timer(nullptr);
+
+    for (size_t count = 2; count <= 65536; count *= 2) {
+        const std::vector<Interval> intervals = RandomIntervals(random, count, range, range / count + 1);
+        const std::vector<Interval> targets = RandomIntervals(random, 64, range, range / 100);
+        size_t covered = 0;
+
+        const double sorting = Measure([&]() {
+            for (int repeat = 0; repeat < 4096 / static_cast<int>(std::min<size_t>(count, 4096)) + 1; ++repeat) {
+                for (const Interval &target : targets) {
+                    covered += IsIntervalInUnionBySorting(target, intervals, timer);
+                }
+            }
+        });
+        const double clipping = Measure([&]() {
+            for (int repeat = 0; repeat < 4096 / static_cast<int>(std::min<size_t>(count, 4096)) + 1; ++repeat) {
+                for (const Interval &target : targets) {
+                    covered += IsIntervalInUnionByClipping(target, intervals, timer);
+                }
+            }
+        });
+
+        if (clipping < sorting && covered != std::numeric_limits<size_t>::max()) {
+            return count;
+        }
+    }
+
+    return std::numeric_limits<size_t>::max();
+}
+
+// Smallest number of targets (a power of 2) from which building an index beats checking them one by one, against a
+// collection of 64K Intervals
+size_t TuneIndexedQueries(std::mt19937_64 &random) {
+    const long int range = 100000000;
+    const std::vector<Interval> intervals = RandomIntervals(random, 65536, range, 2000);
+
+    for (size_t count = 1; count <= 1024; count *= 2) {
+        const std::vector<Interval> targets = RandomIntervals(random, count, range, 100);
+        size_t covered = 0;
+
+        const double oneByOne = Measure([&]() {
+            for (const Interval &target : targets) {
+                covered += IsIntervalInUnionOfOthers(target, intervals);
+            }
+        });
+        const double indexed = Measure([&]() {
+            const CoverageIndex index(intervals);
+            for (const Interval &target : targets) {
+                covered += index.Contains(target);
+            }
+        });
+
+        if (indexed < oneByOne && covered != std::numeric_limits<size_t>::max()) {
+            return count;
+        }
+    }
+
+    return std::numeric_limits<size_t>::max();
+}
+
+}
+
+int main(int argc, char **argv) {
+    const std::string path = (argc > 1) ? argv[1] : "intervals.tune";
+    std::mt19937_64 random(20240101);
+
+    // Tuned in order, each later measurement runs with the sorting thresholds found before it
+    DispatchThresholds thresholds;
+
+    thresholds.sortingNetworkMax = TuneSortingNetwork(random);
+    std::printf("sortingNetworkMax = %zu\n", thresholds.sortingNetworkMax);
+
+    thresholds.radixSortMin = TuneRadixSort(random);
+    std::printf("radixSortMin = %zu\n", thresholds.radixSortMin);
+    SetDispatchThresholds(thresholds);
+
+    thresholds.clipScanMin = TuneClipScan(random);
+    std::printf("clipScanMin = %zu\n", thresholds.clipScanMin);
+    SetDispatchThresholds(thresholds);
+
+    thresholds.indexedQueriesMin = TuneIndexedQueries(random);
+    std::printf("indexedQueriesMin = %zu\n", thresholds.indexedQueriesMin);
+
+    std::ofstream config(path, std::ios::trunc);
+    config << "# Dispatch thresholds measured by autotune on this host\n"
+           << "sortingNetworkMax = " << thresholds.sortingNetworkMax << '\n'
+           << "radixSortMin = " << thresholds.radixSortMin << '\n'
+           << "clipScanMin = " << thresholds.clipScanMin << '\n'
+           << "indexedQueriesMin = " << thresholds.indexedQueriesMin << '\n';
+
+    if (!config.flush()) {
+        std::fprintf(stderr, "Can't write %s\n", path.c_str());
+        return 1;
+    }
+
+    std::printf("Written to %s, use it with INTERVALS_TUNING=%s\n", path.c_str(), path.c_str());
+    return 0;
+}
@@ -0,0 +1,643 @@
+// Replays a query trace (see BasicQueryTraceRecorder) against the coverage backends & reports their throughput and
+// query latencies
+// * Every backend is built from the inputs of every build in the trace, then the queries are re-driven in the recorded
+//   order, split into contiguous runs between the threads - the answers are checked against the recorded ones
+// * Recorded IsIntervalInUnionOfOthers calls (UnionContains) are replayed as Contains, like the index queries
+// * MergeIntervals is measured on the (sorted) inputs of the builds as well, in Intervals per second
+// * With --repetitions every measurement is repeated & summarised by its median and median absolute deviation (MAD),
+//   --json writes the samples & summaries out so a run can be kept as a baseline
+// * --baseline compares the run against such a file: a throughput that dropped by more than --threshold percent
+//   (default 5) and by more than 3 scaled MADs of noise is a regression - the MAD part keeps noisy hosts from failing
+//   on a single slow repetition, so use at least 5 repetitions on both sides
+// * Exit codes: 0 success, 1 answers not matching the trace, 2 usage or file errors, 3 regressions against the baseline
+// * Build with e.g: g++ -std=c++20 -O2 -mavx2 -pthread benchmark.cxx -o benchmark
+//
+// Usage: benchmark <trace or directory of .trace files> [--backend <name>|all] [--threads <n>] [--repetitions <n>]
+//                  [--json <output path>] [--baseline <json path>] [--threshold <percent>]
+
+#include "intervals.cxx"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Adapters giving every backend the same Build & query members, each holding one instance per build of the trace
+// * Point queries go through Contains of [point, point] where a backend has no ContainsPoint
+
+struct OriginalBackend {
+    static constexpr const char *name = "original";
+
+    explicit OriginalBackend(const std::vector<Interval> &intervals) : _intervals(intervals) {}
+
+    bool Contains(const Interval &interval) const { return IsIntervalInUnionOfOthers(interval, _intervals); }
+    bool ContainsPoint(long int point) const { return Contains(Interval(point, point)); }
+
+    std::vector<Interval> _intervals;
+};
+
+struct CoverageBackend {
+    static constexpr const char *name = "coverage";
+
+    explicit CoverageBackend(const std::vector<Interval> &intervals) : _index(intervals) {}
+
+    bool Contains(const Interval &interval) const { return _index.Contains(interval); }
+    bool ContainsPoint(long int point) const { return _index.ContainsPoint(point); }
+
+    CoverageIndex _index;
+};
+
+struct BlockBackend {
+    static constexpr const char *name = "block";
+
+    explicit BlockBackend(const std::vector<Interval> &intervals) : _index(intervals) {}
+
+    bool Contains(const Interval &interval) const { return _index.Contains(interval); }
+    bool ContainsPoint(long int point) const { return _index.ContainsPoint(point); }
+
+    BlockCoverageIndex _index;
+};
+
+struct ShardedBackend {
+    static constexpr const char *name = "sharded";
+
+    explicit ShardedBackend(const std::vector<Interval> &intervals) {
+        for (const Interval &interval : intervals) {
+            _set.Insert(interval);
+        }
+    }
+
+    bool Contains(const Interval &interval) const { return _set.Contains(interval); }
+    bool ContainsPoint(long int point) const { return _set.Contains(Interval(point, point)); }
+
+    ShardedIntervalSet _set;
+};
+
+struct ConcurrentBackend {
+    static constexpr const char *name = "concurrent";
+
+    explicit ConcurrentBackend(const std::vector<Interval> &intervals) {
+        for (const Interval &interval : intervals) {
+            _set.Insert(interval);
+        }
+    }
+
+    bool Contains(const Interval &interval) const { return _set.Contains(interval); }
+    bool ContainsPoint(long int point) const { return _set.ContainsPoint(point); }
+
+    ConcurrentIntervalSet _set;
+};
+
+struct SeqlockBackend {
+    static constexpr const char *name = "seqlock";
+
+    // Note: throws std::length_error for collections past its capacity, reported as the backend being skipped
+    explicit SeqlockBackend(const std::vector<Interval> &intervals) {
+        _set.Assign(intervals);
+    }
+
+    bool Contains(const Interval &interval) const { return _set.Contains(interval); }
+    bool ContainsPoint(long int point) const { return _set.ContainsPoint(point); }
+
+    SeqlockIntervalSet _set;
+};
+
+struct ReplayResult {
+    bool skipped = false;
+    double buildSeconds = 0.0;
+    double replaySeconds = 0.0;
+    size_t queries = 0;
+    size_t mismatches = 0;
+    std::vector<double> latencies;
+};
+
+template <typename Backend>
+bool RunQuery(const Backend &backend, const QueryTrace &trace, const QueryTrace::Query &query) {
+    switch (query.kind) {
+    case TraceRecord::Contains:
+    case TraceRecord::UnionContains:
+        return backend.Contains(Interval(query.min, query.max)) == query.result;
+    case TraceRecord::ContainsPoint:
+        return backend.ContainsPoint(query.min) == query.result;
+    default: {
+        // No answers are recorded for batches, the backend still has to do the work
+        size_t covered = 0;
+        for (size_t i = 0; i < query.count; ++i) {
+            covered += backend.ContainsPoint(trace.points[query.first + i]);
+        }
+        return covered <= query.count;
+    }
+    }
+}
+
+template <typename Backend>
+ReplayResult Replay(const QueryTrace &trace, unsigned threads) {
+    ReplayResult result;
+    std::vector<std::unique_ptr<Backend>> backends;
+
+    const Clock::time_point buildStart = Clock::now();
+    try {
+        for (const QueryTrace::Build &build : trace.builds) {
+            backends.push_back(std::make_unique<Backend>(build.intervals));
+        }
+    }
+    catch (const std::length_error &) {
+        result.skipped = true;
+        return result;
+    }
+    result.buildSeconds = std::chrono::duration<double>(Clock::now() - buildStart).count();
+
+    const size_t count = trace.queries.size();
+    std::vector<double> latencies(count);
+    std::vector<size_t> mismatches(threads, 0);
+    std::vector<std::thread> running;
+
+    const Clock::time_point replayStart = Clock::now();
+    for (unsigned thread = 0; thread < threads; ++thread) {
+        running.emplace_back([&, thread]() {
+            const size_t from = thread * count / threads;
+            const size_t to = (thread + 1) * count / threads;
+
+            for (size_t i = from; i < to; ++i) {
+                const QueryTrace::Query &query = trace.queries[i];
+                const Clock::time_point start = Clock::now();
+                const bool matches = RunQuery(*backends[query.build], trace, query);
+                latencies[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                mismatches[thread] += !matches;
+            }
+        });
+    }
+    for (std::thread &thread : running) {
+        thread.join();
+    }
+    result.replaySeconds = std::chrono::duration<double>(Clock::now() - replayStart).count();
+
+    result.queries = count;
+    for (size_t threadMismatches : mismatches) {
+        result.mismatches += threadMismatches;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    result.latencies = std::move(latencies);
+    return result;
+}
+
+double Percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())))];
+}
+
+double Median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return (values.size() % 2) ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+// Repeated measurements of one throughput (per second, higher is better) & their median / median absolute deviation
+struct Series {
+    std::string name;
+    std::vector<double> samples;
+    double median = 0.0;
+    double mad = 0.0;
+
+    Series() = default;
+    Series(std::string seriesName, std::vector<double> seriesSamples)
+        : name(std::move(seriesName)), samples(std::move(seriesSamples)), median(Median(samples)) {
+        std::vector<double> deviations;
+        for (double sample : samples) {
+            deviations.push_back(std::abs(sample - median));
+        }
+        mad = Median(deviations);
+    }
+};
+
+void Report(const char *name, const ReplayResult &result, const Series &throughput) {
+    if (result.skipped) {
+        std::printf("%-11s skipped (collection doesn't fit the backend)\n", name);
+        return;
+    }
+
+    std::printf("%-11s %10.3f %14.0f %12.0f %9.0f %9.0f %9.0f %9.0f %10.0f %10zu\n", name, result.buildSeconds * 1e3,
+                throughput.median, throughput.mad, Percentile(result.latencies, 0.5), Percentile(result.latencies, 0.9),
+                Percentile(result.latencies, 0.99), Percentile(result.latencies, 0.999),
+                result.latencies.empty() ? 0.0 : result.latencies.back(), result.mismatches);
+}
+
+// Replays the trace repetitions times, the latencies of all of them are pooled & the throughput of each is a sample
+template <typename Backend>
+bool ReplayAndReport(const QueryTrace &trace, const std::string &traceName, const std::string &backend, unsigned threads,
+                     size_t repetitions, std::vector<Series> &series) {
+    if (backend != "all" && backend != Backend::name) {
+        return true;
+    }
+
+    ReplayResult pooled;
+    std::vector<double> throughputs;
+    for (size_t repetition = 0; repetition < repetitions; ++repetition) {
+        ReplayResult result = Replay<Backend>(trace, threads);
+        if (result.skipped) {
+            Report(Backend::name, result, Series());
+            return true;
+        }
+
+        throughputs.push_back(result.replaySeconds > 0.0 ? static_cast<double>(result.queries) / result.replaySeconds : 0.0);
+        pooled.buildSeconds += result.buildSeconds / static_cast<double>(repetitions);
+        pooled.queries += result.queries;
+        pooled.mismatches += result.mismatches;
+        pooled.latencies.insert(pooled.latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    std::sort(pooled.latencies.begin(), pooled.latencies.end());
+
+    series.emplace_back(traceName + ":" + Backend::name, std::move(throughputs));
+    Report(Backend::name, pooled, series.back());
+    return pooled.mismatches == 0;
+}
+
+// MergeIntervals over the sorted inputs of every build of the trace, in Intervals per second
+// * Each repetition merges them over & over for at least 20ms so small traces still get a stable figure
+Series MeasureMerge(const QueryTrace &trace, const std::string &traceName, size_t repetitions) {
+    std::vector<std::vector<Interval>> inputs;
+    size_t intervals = 0;
+    for (const QueryTrace::Build &build : trace.builds) {
+        inputs.push_back(build.intervals);
+        std::sort(inputs.back().begin(), inputs.back().end());
+        intervals += build.intervals.size();
+    }
+
+    std::vector<double> throughputs;
+    size_t sink = 0;
+    for (size_t repetition = 0; repetition < repetitions && intervals > 0; ++repetition) {
+        size_t merged = 0;
+        const Clock::time_point start = Clock::now();
+        double seconds = 0.0;
+        do {
+            for (std::vector<Interval> &input : inputs) {
+                sink += MergeIntervals(input).size();
+            }
+            merged += intervals;
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < 0.02);
+        throughputs.push_back(static_cast<double>(merged) / seconds);
+    }
+
+    // Keeps the work from being optimised away
+    if (sink == std::numeric_limits<size_t>::max()) {
+        std::printf("?");
+    }
+
+    Series series(traceName + ":merge", std::move(throughputs));
+    std::printf("%-11s %10s %14.0f %12.0f  (Intervals/s)\n", "merge", "", series.median, series.mad);
+    return series;
+}
+
+std::string JsonString(const std::string &value) {
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            quoted += escaped;
+        }
+        else {
+            quoted += c;
+        }
+    }
+    return quoted + '"';
+}
+
+bool WriteJson(const std::string &path, const std::vector<Series> &series, unsigned threads, size_t repetitions) {
+    std::ofstream output(path, std::ios::trunc);
+    output << std::setprecision(std::numeric_limits<double>::max_digits10);
+    output << "{\n  \"version\": 1,\n  \"threads\": " << threads << ",\n  \"repetitions\": " << repetitions
+           << ",\n  \"results\": [";
+
+    for (size_t i = 0; i < series.size(); ++i) {
+        output << (i ? ",\n" : "\n") << "    {\"name\": " << JsonString(series[i].name) << ", \"unit\": \"per_second\", "
+               << "\"median\": " << series[i].median << ", \"mad\": " << series[i].mad << ", \"samples\": [";
+        for (size_t j = 0; j < series[i].samples.size(); ++j) {
+            output << (j ? ", " : "") << series[i].samples[j];
+        }
+        output << "]}";
+    }
+    output << "\n  ]\n}\n";
+
+    return static_cast<bool>(output.flush());
+}
+
+// Just enough of a JSON reader for the files WriteJson writes (or hand-edited copies of them): the name, median & mad
+// of every object in the "results" array, everything else is skipped
+class BaselineReader {
+public:
+    explicit BaselineReader(std::string text) : _text(std::move(text)) {}
+
+    std::vector<Series> Read() {
+        std::vector<Series> series;
+        Expect('{');
+        if (!Consume('}')) {
+            do {
+                const std::string key = ReadString();
+                Expect(':');
+                if (key == "results") {
+                    ReadResults(series);
+                }
+                else {
+                    SkipValue();
+                }
+            } while (Consume(','));
+            Expect('}');
+        }
+        return series;
+    }
+
+private:
+    void ReadResults(std::vector<Series> &series) {
+        Expect('[');
+        if (Consume(']')) {
+            return;
+        }
+        do {
+            Series result;
+            Expect('{');
+            if (!Consume('}')) {
+                do {
+                    const std::string key = ReadString();
+                    Expect(':');
+                    if (key == "name") {
+                        result.name = ReadString();
+                    }
+                    else if (key == "median") {
+                        result.median = ReadNumber();
+                    }
+                    else if (key == "mad") {
+                        result.mad = ReadNumber();
+                    }
+                    else {
+                        SkipValue();
+                    }
+                } while (Consume(','));
+                Expect('}');
+            }
+            series.push_back(std::move(result));
+        } while (Consume(','));
+        Expect(']');
+    }
+
+    void SkipWhitespace() {
+        while (_position < _text.size() && std::isspace(static_cast<unsigned char>(_text[_position]))) {
+            ++_position;
+        }
+    }
+
+    bool Consume(char c) {
+        SkipWhitespace();
+        if (_position < _text.size() && _text[_position] == c) {
+            ++_position;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c) {
+        if (!Consume(c)) {
+            throw std::runtime_error(std::string("Malformed baseline: expected '") + c + "' at offset " + std::to_string(_position));
+        }
+    }
+
+    std::string ReadString() {
+        Expect('"');
+        std::string value;
+        while (_position < _text.size() && _text[_position] != '"') {
+            if (_text[_position] == '\\' && _position + 1 < _text.size()) {
+                ++_position;
+                if (_text[_position] == 'u' && _position + 4 < _text.size()) {
+                    value += static_cast<char>(std::stoi(_text.substr(_position + 1, 4), nullptr, 16));
+                    _position += 5;
+                    continue;
+                }
+                const char escaped = _text[_position];
+                value += (escaped == 'n') ? '\n' : (escaped == 't') ? '\t' : escaped;
+            }
+            else {
+                value += _text[_position];
+            }
+            ++_position;
+        }
+        Expect('"');
+        return value;
+    }
+
+    double ReadNumber() {
+        SkipWhitespace();
+        const char *start = _text.c_str() + _position;
+        char *end = nullptr;
+        const double value = std::strtod(start, &end);
+        if (end == start) {
+            throw std::runtime_error("Malformed baseline: expected a number at offset " + std::to_string(_position));
+        }
+        _position += static_cast<size_t>(end - start);
+        return value;
+    }
+
+    void SkipValue() {
+        SkipWhitespace();
+        if (_position >= _text.size()) {
+            throw std::runtime_error("Malformed baseline: unexpected end");
+        }
+
+        const char c = _text[_position];
+        if (c == '"') {
+            ReadString();
+        }
+        else if (c == '{' || c == '[') {
+            const char close = (c == '{') ? '}' : ']';
+            ++_position;
+            if (Consume(close)) {
+                return;
+            }
+            do {
+                if (c == '{') {
+                    ReadString();
+                    Expect(':');
+                }
+                SkipValue();
+            } while (Consume(','));
+            Expect(close);
+        }
+        else if (std::isalpha(static_cast<unsigned char>(c))) {
+            // true, false, null
+            while (_position < _text.size() && std::isalpha(static_cast<unsigned char>(_text[_position]))) {
+                ++_position;
+            }
+        }
+        else {
+            ReadNumber();
+        }
+    }
+
+    std::string _text;
+    size_t _position = 0;
+};
+
+std::vector<Series> LoadBaseline(const std::string &path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::runtime_error("Can't open baseline " + path);
+    }
+
+    std::stringstream text;
+    text << input.rdbuf();
+    return BaselineReader(text.str()).Read();
+}
+
+// Prints the change of every series found in both runs, returns the number of regressions
+size_t CompareWithBaseline(const std::vector<Series> &baseline, const std::vector<Series> &current, double threshold) {
+    // MAD * 1.4826 estimates the standard deviation of normally distributed samples
+    constexpr double madToDeviation = 1.4826;
+    size_t regressions = 0;
+
+    std::printf("\n%-40s %14s %14s %9s\n", "baseline comparison", "baseline/s", "current/s", "change");
+    for (const Series &result : current) {
+        auto found = std::find_if(baseline.begin(), baseline.end(), [&](const Series &s) { return s.name == result.name; });
+        if (found == baseline.end()) {
+            std::printf("%-40s %14s %14.0f %9s\n", result.name.c_str(), "-", result.median, "new");
+            continue;
+        }
+
+        const double drop = found->median - result.median;
+        const double noise = 3.0 * madToDeviation * std::hypot(found->mad, result.mad);
+        const double change = (found->median > 0.0) ? -drop / found->median * 100.0 : 0.0;
+        const bool regressed = drop > threshold / 100.0 * found->median && drop > noise;
+
+        regressions += regressed;
+        std::printf("%-40s %14.0f %14.0f %+8.1f%%%s\n", result.name.c_str(), found->median, result.median, change,
+                    regressed ? "  REGRESSION" : "");
+    }
+
+    return regressions;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <trace or directory> [--backend <name>|all] [--threads <n>]\n", argv[0]);
+        return 2;
+    }
+
+    std::string backend = "all";
+    unsigned threads = 1;
+    size_t repetitions = 1;
+    std::string jsonPath;
+    std::string baselinePath;
+    double threshold = 5.0;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        if (option == "--backend") {
+            backend = argv[i + 1];
+        }
+        else if (option == "--threads") {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--repetitions") {
+            repetitions = static_cast<size_t>(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--json") {
+            jsonPath = argv[i + 1];
+        }
+        else if (option == "--baseline") {
+            baselinePath = argv[i + 1];
+        }
+        else if (option == "--threshold") {
+            threshold = std::max(0.0, std::atof(argv[i + 1]));
+        }
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    // A directory (e.g the corpus of perf_fuzzer.cxx) replays every .trace file in it, in name order
+    std::vector<std::string> paths;
+    if (std::filesystem::is_directory(argv[1])) {
+        for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(argv[1])) {
+            if (entry.path().extension() == ".trace") {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+    }
+    else {
+        paths.push_back(argv[1]);
+    }
+
+    // Loaded up front so a bad baseline fails before the (possibly long) run
+    std::vector<Series> baseline;
+    if (!baselinePath.empty()) {
+        try {
+            baseline = LoadBaseline(baselinePath);
+        }
+        catch (const std::exception &error) {
+            std::fprintf(stderr, "%s\n", error.what());
+            return 2;
+        }
+    }
+
+    bool matches = true;
+    std::vector<Series> series;
+    for (const std::string &path : paths) {
+        QueryTrace trace;
+        try {
+            trace = QueryTrace::Load(path);
+        }
+        catch (const std::exception &error) {
+            std::fprintf(stderr, "%s\n", error.what());
+            return 2;
+        }
+
+        // Series are named by file name rather than path, so a baseline stays valid wherever the traces are kept
+        const std::string traceName = std::filesystem::path(path).filename().string();
+
+        std::printf("%s: %zu builds, %zu queries, %u threads, %zu repetitions\n", path.c_str(), trace.builds.size(),
+                    trace.queries.size(), threads, repetitions);
+        std::printf("%-11s %10s %14s %12s %9s %9s %9s %9s %10s %10s\n", "backend", "build ms", "queries/s", "MAD/s",
+                    "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns", "mismatches");
+
+        matches &= ReplayAndReport<OriginalBackend>(trace, traceName, backend, threads, repetitions, series);
+        matches &= ReplayAndReport<CoverageBackend>(trace, traceName, backend, threads, repetitions, series);
+        matches &= ReplayAndReport<BlockBackend>(trace, traceName, backend, threads, repetitions, series);
+        matches &= ReplayAndReport<ShardedBackend>(trace, traceName, backend, threads, repetitions, series);
+        matches &= ReplayAndReport<ConcurrentBackend>(trace, traceName, backend, threads, repetitions, series);
+        matches &= ReplayAndReport<SeqlockBackend>(trace, traceName, backend, threads, repetitions, series);
+        series.push_back(MeasureMerge(trace, traceName, repetitions));
+    }
+
+    if (!jsonPath.empty() && !WriteJson(jsonPath, series, threads, repetitions)) {
+        std::fprintf(stderr, "Can't write %s\n", jsonPath.c_str());
+        return 2;
+    }
+
+    if (!matches) {
+        return 1;
+    }
+
+    if (!baselinePath.empty() && CompareWithBaseline(baseline, series, threshold) > 0) {
+        return 3;
+    }
+
+    return 0;
+}
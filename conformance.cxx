@@ -0,0 +1,2048 @@
+// Checks every coverage backend against the reference semantics of the original IsIntervalInUnionOfOthers, then
+// measures each of them on each input distribution
+// * Conformance: many small random collections per distribution, each queried with random targets & with the edge
+//   cases derived from its Intervals (the Intervals themselves, one element past either end, single elements at & past
+//   the ends) - any answer differing from the reference is a failure & the exit code is non-zero
+// * The reference is the original implementation, copied in as it was (see Baseline), so it shares no code with the
+//   backends. It runs on the closed integer Intervals it was written for - Intervals of the other boundary policies
+//   are converted to the elements they hold first, floating point ones are checked by a plain sweep instead
+// * Every backend runs on every domain it supports: long & double, each with closed, half-open & open Intervals.
+//   Tagged & weighted backends get varied tags & weights, checked against the reference over the Intervals selected
+// * EndpointIndex is checked against a brute force search, rectangles & boxes against every elementary cell of the
+//   target in 2 & 3 dimensions. ContainsPoints, in & out of order, against ContainsPoint & the exception-free API
+//   (TryMergeIntervals, Make, TrySetMax) against the errors it should report. Budgeted builds against MergeIntervals,
+//   over & under budget, spilled & in memory, with their progress reports & cancellation. Footprint() of the indexes
+//   & sets against the Intervals they keep, coverage heatmaps against a brute force depth count
+// * Concurrency: writer threads inserting into the concurrent sets (or pushing into the ingestor, a single writer for
+//   the seqlock set) while as many reader threads query them - readers check that every Insert a writer has finished
+//   is visible, & the final contents have to equal MergeIntervals of everything inserted. Worth running under
+//   ThreadSanitizer as well, e.g:
+//   g++ -std=c++20 -O1 -g -fsanitize=thread -pthread conformance.cxx -o conformance-tsan
+//   TSAN_OPTIONS=detect_deadlocks=0 ./conformance-tsan --seeds 20 --size 1000 --queries 1000
+//   (coalescing inserts hold more locks at once than the deadlock detector can track, it gives up otherwise) - and
+//   under AddressSanitizer (-fsanitize=address), which catches nodes freed while a reader can still reach them
+// * Large collections (--large Intervals) for the paths only split over threads from ~64K Intervals on, each with 1, 3
+//   & 8 threads: union & intersection of merged sets against merging both & clipping overlapping pairs. The radix
+//   sort SortIntervals switches to from radixSortMin on against std::stable_sort, box indexes (of an eighth as many
+//   boxes) against the elementary cell reference & coverage heatmaps against a brute force depth count. The heap
+//   budgeted builds peak at (counted by a replaced operator new) against their budget, from 64 Intervals up
+// * Performance: one large collection per distribution, reporting build time, query throughput & the heap the built
+//   backend holds (measured with glibc's mallinfo2, so 0 elsewhere) - closed long Intervals only
+// * Queries go through the same std::function for every backend, so the throughput figures compare fairly with
+//   each other but include that call
+// * Build with e.g: g++ -std=c++20 -O2 -mavx2 -pthread conformance.cxx -o conformance
+//
+// Usage: conformance [--seeds <n>] [--size <n>] [--queries <n>] [--threads <n>] [--large <n>]
+
+#include "intervals.cxx"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// Heap accounting for the budget checks (see CheckBudgetPeak): the bytes asked for through operator new & not freed yet
+// while counting is on, & the most of them at any one time
+// * Each allocation carries its size & whether it was counted in a header in front of it, so whatever was allocated
+//   before counting started doesn't count when it's freed
+// * The aligned variants aren't replaced, they neither come through here nor free anything that did
+namespace Allocations {
+
+std::atomic<bool> counting{false};
+std::atomic<long int> live{0};
+std::atomic<long int> peak{0};
+
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+    size_t size;
+    bool counted;
+};
+
+}
+
+void* operator new(size_t size) {
+    using namespace Allocations;
+
+    void *block = std::malloc(sizeof(Header) + size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    Header *header = new (block) Header{size, counting.load(std::memory_order_relaxed)};
+    if (header->counted) {
+        const long int now = live.fetch_add(static_cast<long int>(size), std::memory_order_relaxed) + static_cast<long int>(size);
+        for (long int highest = peak.load(std::memory_order_relaxed); highest < now;) {
+            peak.compare_exchange_weak(highest, now, std::memory_order_relaxed);
+        }
+    }
+    return header + 1;
+}
+
+void operator delete(void *pointer) noexcept {
+    using namespace Allocations;
+
+    if (pointer == nullptr) {
+        return;
+    }
+
+    Header *header = static_cast<Header *>(pointer) - 1;
+    if (header->counted && counting.load(std::memory_order_relaxed)) {
+        live.fetch_sub(static_cast<long int>(header->size), std::memory_order_relaxed);
+    }
+    std::free(header);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// The original algorithm, as it was before any of the backends existed: sort & merge the collection, then check if
+// merging the target into it changes anything
+// * Copied from the first version of intervals.cxx, the only change being the adjacency check of MergeIntervals
+//   testing Max() < Min() before the + 1, so the + 1 can't overflow at the top of the domain
+namespace Baseline {
+
+// Represents a closed interval [min, max]
+// * Enforces min < max
+//
+// * Note: No it doesn't - the constructor, as it's implemented enforces min <= max. Will leave it as it is to support degenerate intervals
+class Interval {
+public:
+    typedef long int Integer;
+
+    Interval(Integer min, Integer max) : _min(min), _max(max) {
+        if (_max < _min) {
+            std::swap(_min, _max);
+        }
+    }
+
+    Integer Min() const { return _min; }
+    Integer Max() const { return _max; }
+
+    // Added a setter as the alternative to modyfying an Interval would be inserting & removing elements during merging
+    // * I find this aproach both cleaner and faster (than shifting elements in vector)
+    void SetMax(Integer max) {
+        // Note: assuming that degenerate intervals (e.g [1, 1]) are permitted, hence >=
+        if (max >= _min) [[likely]] {
+            _max = max;
+        }
+        else {
+            throw std::invalid_argument("Attempting to set max that is less than current min");
+        }
+    }
+
+    // Overloading < operator will allow the use of std::sort on Interval
+    bool operator < (const Interval  &other) const {
+        return (_min < other.Min());
+    }
+
+private:
+    Integer _min;
+    Integer _max;
+};
+
+// Overloading == operator will allow for easy (in terms of syntax, at least) comparing vector<Interval>
+bool operator == (const Interval& lhs, const Interval& rhs) {
+    return (lhs.Min() == rhs.Min() && lhs.Max() == rhs.Max());
+}
+
+// Merges overlapping Intervals and returns them in a vector
+std::vector<Interval> MergeIntervals(std::vector<Interval> &intervals) {
+    // Construct output vector from 1st element of intervals
+    std::vector<Interval> output (1, intervals.front());
+
+    for (size_t i = 1; i < intervals.size(); ++i) {
+        Interval& lastInterval = output.back();
+
+        // Check if Intervals are overlaping: e.g the min of a given Interval is <= max of the preceeding Interval +1
+        // * The +1 is there to account for Intervals being a closed integral intervals
+        // * so [-1, 1] and [2, 5] do overlap
+        if (lastInterval.Max() < intervals[i].Min() && lastInterval.Max() + 1 < intervals[i].Min()) {
+            output.push_back(intervals[i]);
+        }
+        else if (lastInterval.Max() < intervals[i].Max()) {
+            lastInterval.SetMax(intervals[i].Max());
+        }
+    }
+
+    return output;
+}
+
+// Returns true if every element of Interval under test is contained in the union of Intervals in the vector
+bool IsIntervalInUnionOfOthers(const Interval &interval, const std::vector<Interval> &intervals) {
+    if (intervals.empty()) {
+        return false;
+    }
+
+    // Need a local copy due to intervals being const reference
+    // * The prefered aproach would be taking a non-const reference, which seems acceptable in this particular exercise
+    std::vector<Interval> intervalsCopy(intervals);
+
+    // Sort the list of intervals by the min, in ascending order
+    // * as having an ordered elements simplifies merging of Intervals
+    std::sort(intervalsCopy.begin(), intervalsCopy.end());
+
+    intervalsCopy = MergeIntervals(intervalsCopy);
+
+    // Copy-constructing another vector to hold all the Interval collection as well as Interval under test
+    std::vector<Interval> allIntervals(intervalsCopy);
+
+    // Insert the Interval under test at the correct position in the vector to preserve its ordering
+    allIntervals.insert(lower_bound(allIntervals.begin(), allIntervals.end(), interval), interval);
+
+    // Merge all Intervals, then check if if the resulting vector differs from intervalsCopy
+    // * If it does, there must have been elements of Interval under test that were not present in the collection of Intervals
+    return (MergeIntervals(allIntervals) == intervalsCopy);
+}
+
+}
+
+// The elements [first, last] of an integral Interval of any boundary policy, or nothing if it holds none
+template <typename T, typename Boundary>
+std::optional<Baseline::Interval> ElementsOf(const BasicInterval<T, Boundary> &interval) {
+    const T min = interval.Min();
+    const T max = interval.Max();
+
+    if ((!Boundary::includesMin && min == std::numeric_limits<T>::max()) ||
+        (!Boundary::includesMax && max == std::numeric_limits<T>::min())) {
+        return std::nullopt;
+    }
+
+    const T first = Boundary::includesMin ? min : min + 1;
+    const T last = Boundary::includesMax ? max : max - 1;
+    if (last < first) {
+        return std::nullopt;
+    }
+    return Baseline::Interval(first, last);
+}
+
+// Sweeps the Intervals in the order of their mins, extending how far the target is known to be covered
+// * The set of reals the Interval stands for, not its elements, so only the ends the policy includes count
+template <typename T, typename Boundary>
+bool SweepIsIntervalInUnion(const BasicInterval<T, Boundary> &interval, std::vector<BasicInterval<T, Boundary>> intervals) {
+    const T from = interval.Min();
+    const T to = interval.Max();
+
+    if ((!Boundary::includesMin || !Boundary::includesMax) && from == to) {
+        return true;
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+
+    if constexpr (Boundary::includesMin && Boundary::includesMax) {
+        // [from, reach] is covered once started
+        bool started = false;
+        T reach = from;
+        for (const BasicInterval<T, Boundary> &other : intervals) {
+            if (reach < other.Min()) {
+                break;
+            }
+            if (reach <= other.Max()) {
+                started = true;
+                reach = other.Max();
+            }
+        }
+        return started && to <= reach;
+    }
+    else {
+        // [from, reach) or (from, reach) is covered, for open Intervals reach itself never is (it's the max of one) - so
+        // past the start the next one has to begin strictly before it
+        T reach = from;
+        for (const BasicInterval<T, Boundary> &other : intervals) {
+            if (reach < other.Min() || (!Boundary::includesMin && other.Min() == reach && from < reach)) {
+                break;
+            }
+            reach = std::max(reach, other.Max());
+        }
+        return to <= reach;
+    }
+}
+
+template <typename T, typename Boundary>
+bool ReferenceIsIntervalInUnionOfOthers(const BasicInterval<T, Boundary> &interval,
+                                        const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return SweepIsIntervalInUnion(interval, intervals);
+    }
+    else {
+        const std::optional<Baseline::Interval> target = ElementsOf(interval);
+        if (!target) {
+            return true;
+        }
+
+        std::vector<Baseline::Interval> elements;
+        for (const BasicInterval<T, Boundary> &other : intervals) {
+            if (const std::optional<Baseline::Interval> held = ElementsOf(other)) {
+                elements.push_back(*held);
+            }
+        }
+        return Baseline::IsIntervalInUnionOfOthers(*target, elements);
+    }
+}
+
+// A backend built from a collection, answering "is this Interval in the union of the collection"
+template <typename IntervalType>
+struct Built {
+    std::shared_ptr<void> state;
+    std::function<bool(const IntervalType&)> contains;
+};
+
+// keeps (if set) selects the Intervals whose union the backend answers for, by their position in the collection
+template <typename IntervalType>
+struct Backend {
+    const char *name;
+    std::function<Built<IntervalType>(const std::vector<IntervalType>&)> build;
+    std::function<bool(size_t)> keeps;
+};
+
+template <typename IntervalType, typename State, typename Contains>
+Built<IntervalType> Make(std::shared_ptr<State> state, Contains contains) {
+    return Built<IntervalType>{state, [state, contains](const IntervalType &interval) { return contains(*state, interval); }};
+}
+
+template <typename T, typename Boundary>
+std::vector<Backend<BasicInterval<T, Boundary>>> Backends() {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    typedef BasicCoverageIndex<T, Boundary> IndexType;
+    typedef std::vector<IntervalType> Intervals;
+
+    std::vector<Backend<IntervalType>> backends;
+
+    const auto indexed = [](IndexType index) {
+        return Make<IntervalType>(std::make_shared<IndexType>(std::move(index)),
+                                  [](const IndexType &state, const IntervalType &interval) { return state.Contains(interval); });
+    };
+
+    backends.push_back({"original", [](const Intervals &intervals) {
+        return Make<IntervalType>(std::make_shared<Intervals>(intervals),
+                                  [](const Intervals &state, const IntervalType &interval) { return IsIntervalInUnionOfOthers(interval, state); });
+    }, nullptr});
+    backends.push_back({"sorting", [](const Intervals &intervals) {
+        return Make<IntervalType>(std::make_shared<Intervals>(intervals), [](const Intervals &state, const IntervalType &interval) {
+            SlowQueryLog::Timer timer(nullptr);
+            return interval.IsEmpty() || (!state.empty() && IsIntervalInUnionBySorting(interval, state, timer));
+        });
+    }, nullptr});
+    backends.push_back({"clipping", [](const Intervals &intervals) {
+        return Make<IntervalType>(std::make_shared<Intervals>(intervals), [](const Intervals &state, const IntervalType &interval) {
+            SlowQueryLog::Timer timer(nullptr);
+            return interval.IsEmpty() || (!state.empty() && IsIntervalInUnionByClipping(interval, state, timer));
+        });
+    }, nullptr});
+    backends.push_back({"batch", [](const Intervals &intervals) {
+        return Make<IntervalType>(std::make_shared<Intervals>(intervals), [](const Intervals &state, const IntervalType &interval) -> bool {
+            return AreIntervalsInUnionOfOthers(Intervals{interval}, state)[0];
+        });
+    }, nullptr});
+    backends.push_back({"try", [](const Intervals &intervals) {
+        return Make<IntervalType>(std::make_shared<Intervals>(intervals), [](const Intervals &state, const IntervalType &interval) {
+            Intervals scratch(state.size(), IntervalType(T{}, T{}));
+            const IntervalExpected<bool> covered = TryIsIntervalInUnionOfOthers(interval.Min(), interval.Max(), state.data(),
+                                                                                state.size(), scratch.data());
+            return covered && *covered;
+        });
+    }, nullptr});
+    backends.push_back({"coverage", [indexed](const Intervals &intervals) {
+        return indexed(IndexType(intervals));
+    }, nullptr});
+    backends.push_back({"builder", [indexed](const Intervals &intervals) {
+        std::vector<T> pairs;
+        for (const IntervalType &interval : intervals) {
+            pairs.push_back(interval.Max());
+            pairs.push_back(interval.Min());
+        }
+        BasicCoverageIndexBuilder<T, Boundary> builder;
+        builder.AppendInterleaved(pairs.data(), intervals.size());
+        return indexed(builder.Build());
+    }, nullptr});
+    backends.push_back({"union", [indexed](const Intervals &intervals) {
+        // Two halves merged separately, then united
+        Intervals first(intervals.begin(), intervals.begin() + intervals.size() / 2);
+        Intervals second(intervals.begin() + intervals.size() / 2, intervals.end());
+        std::sort(first.begin(), first.end());
+        std::sort(second.begin(), second.end());
+        return indexed(IndexType::FromMerged(UnionOfMergedIntervals(MergeIntervals(first), MergeIntervals(second), 4)));
+    }, nullptr});
+    backends.push_back({"intersection", [indexed](const Intervals &intervals) {
+        // The collection intersected with a superset of it (itself plus its Intervals shifted about) is the collection
+        Intervals collection(intervals);
+        Intervals superset(intervals);
+        for (const IntervalType &interval : intervals) {
+            const T shift = static_cast<T>(3);
+            if (interval.Max() < std::numeric_limits<T>::max() - shift) {
+                superset.emplace_back(interval.Min() + (interval.Min() + shift < interval.Max() ? shift : T()), interval.Max() + shift);
+            }
+        }
+        std::sort(collection.begin(), collection.end());
+        std::sort(superset.begin(), superset.end());
+        return indexed(IndexType::FromMerged(IntersectionOfMergedIntervals(MergeIntervals(collection), MergeIntervals(superset), 4)));
+    }, nullptr});
+    backends.push_back({"ingestor", [](const Intervals &intervals) {
+        BasicIntervalIngestor<T, Boundary> ingestor(1024, 256);
+        for (const IntervalType &interval : intervals) {
+            ingestor.Push(interval);
+        }
+        ingestor.Flush();
+        return Make<IntervalType>(std::const_pointer_cast<IndexType>(ingestor.Snapshot()),
+                                  [](const IndexType &state, const IntervalType &interval) { return state.Contains(interval); });
+    }, nullptr});
+    backends.push_back({"concurrent", [](const Intervals &intervals) {
+        typedef BasicConcurrentIntervalSet<T, Boundary> Set;
+        auto set = std::make_shared<Set>();
+        for (const IntervalType &interval : intervals) {
+            set->Insert(interval);
+        }
+        return Make<IntervalType>(set, [](const Set &state, const IntervalType &interval) { return state.Contains(interval); });
+    }, nullptr});
+    backends.push_back({"seqlock", [](const Intervals &intervals) {
+        // Note: throws std::length_error past its capacity, reported as skipped
+        typedef BasicSeqlockIntervalSet<T, Boundary, 1024> Set;
+        auto set = std::make_shared<Set>();
+        set->Assign(intervals);
+        return Make<IntervalType>(set, [](const Set &state, const IntervalType &interval) { return state.Contains(interval); });
+    }, nullptr});
+
+    if constexpr (std::is_integral_v<T>) {
+        backends.push_back({"block32", [](const Intervals &intervals) {
+            typedef BasicBlockCoverageIndex<T, Boundary, std::uint32_t> Index;
+            return Make<IntervalType>(std::make_shared<Index>(intervals), [](const Index &state, const IntervalType &interval) { return state.Contains(interval); });
+        }, nullptr});
+        backends.push_back({"block16", [](const Intervals &intervals) {
+            typedef BasicBlockCoverageIndex<T, Boundary, std::uint16_t> Index;
+            return Make<IntervalType>(std::make_shared<Index>(intervals), [](const Index &state, const IntervalType &interval) { return state.Contains(interval); });
+        }, nullptr});
+
+        // Tags 0, 70 & 140 (3 words of tag bits) in turn, only 0 & 140 allowed
+        backends.push_back({"tagged", [](const Intervals &intervals) {
+            typedef BasicTaggedCoverageIndex<T, Boundary> Index;
+            std::vector<size_t> tags;
+            for (size_t i = 0; i < intervals.size(); ++i) {
+                tags.push_back((i % 3) * 70);
+            }
+            return Make<IntervalType>(std::make_shared<Index>(intervals, tags), [](const Index &state, const IntervalType &interval) {
+                return state.Contains(interval, TagSet{0, 140});
+            });
+        }, [](size_t i) { return i % 3 != 1; }});
+
+        // Weights 0, 1 & 2 in turn, so a total of at least 1 is the union of the ones weighing anything
+        backends.push_back({"weighted", [](const Intervals &intervals) {
+            typedef BasicWeightedCoverageIndex<T, Boundary, long int> Index;
+            std::vector<long int> weights;
+            for (size_t i = 0; i < intervals.size(); ++i) {
+                weights.push_back(static_cast<long int>(i % 3));
+            }
+            return Make<IntervalType>(std::make_shared<Index>(intervals, weights), [](const Index &state, const IntervalType &interval) {
+                return state.Contains(interval, 1);
+            });
+        }, [](size_t i) { return i % 3 != 0; }});
+
+        // The same, but half of it added afterwards - along with decoys removed again - to go through the pending Adds
+        backends.push_back({"weighted+", [](const Intervals &intervals) {
+            typedef BasicWeightedCoverageIndex<T, Boundary, long int> Index;
+            const size_t half = intervals.size() / 2;
+            std::vector<long int> weights;
+            for (size_t i = 0; i < half; ++i) {
+                weights.push_back(static_cast<long int>(i % 3));
+            }
+            auto index = std::make_shared<Index>(Intervals(intervals.begin(), intervals.begin() + half), weights);
+
+            for (size_t i = half; i < intervals.size(); ++i) {
+                index->Add(intervals[i], static_cast<long int>(i % 3));
+                index->Add(intervals[intervals.size() - 1 - i], 7);
+            }
+            for (size_t i = half; i < intervals.size(); ++i) {
+                index->Remove(intervals[intervals.size() - 1 - i], 7);
+            }
+            return Make<IntervalType>(index, [](const Index &state, const IntervalType &interval) { return state.Contains(interval, 1); });
+        }, [](size_t i) { return i % 3 != 0; }});
+    }
+
+    if constexpr (std::is_integral_v<T> && Boundary::includesMin && Boundary::includesMax) {
+        backends.push_back({"sharded", [](const Intervals &intervals) {
+            typedef BasicShardedIntervalSet<T> Set;
+            auto set = std::make_shared<Set>();
+            for (const IntervalType &interval : intervals) {
+                set->Insert(interval);
+            }
+            return Make<IntervalType>(set, [](const Set &state, const IntervalType &interval) { return state.Contains(interval); });
+        }, nullptr});
+        backends.push_back({"box1", [](const Intervals &intervals) {
+            typedef BasicBoxCoverageIndex<T, 1> Index;
+            std::vector<BasicBox<T, 1>> boxes;
+            for (const IntervalType &interval : intervals) {
+                boxes.emplace_back(std::array<IntervalType, 1>{interval});
+            }
+            return Make<IntervalType>(std::make_shared<Index>(boxes), [](const Index &state, const IntervalType &interval) {
+                return state.Contains(BasicBox<T, 1>(std::array<IntervalType, 1>{interval}));
+            });
+        }, nullptr});
+    }
+
+    return backends;
+}
+
+typedef std::mt19937_64 Random;
+
+long int Uniform(Random &random, long int min, long int max) {
+    return std::uniform_int_distribution<long int>(min, max)(random);
+}
+
+// Input distributions, each making a collection of about count Intervals
+// * Made as closed long Intervals, then mapped onto the domain under test (see InDomain)
+struct Distribution {
+    const char *name;
+    std::function<std::vector<Interval>(Random&, size_t)> make;
+};
+
+std::vector<Distribution> Distributions() {
+    const long int lowest = std::numeric_limits<long int>::min();
+    const long int highest = std::numeric_limits<long int>::max();
+
+    return {
+        {"uniform", [](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            const long int range = static_cast<long int>(count) * 50;
+            for (size_t i = 0; i < count; ++i) {
+                const long int min = Uniform(random, 0, range);
+                intervals.emplace_back(min, min + Uniform(random, 0, 100));
+            }
+            return intervals;
+        }},
+        // Chains of Intervals each starting at the Max() + 1 of the previous one, broken by single missing elements
+        {"adjacent", [](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            long int next = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const long int max = next + Uniform(random, 0, 5);
+                intervals.emplace_back(next, max);
+                next = max + ((Uniform(random, 0, 7) == 0) ? 2 : 1);
+            }
+            std::shuffle(intervals.begin(), intervals.end(), random);
+            return intervals;
+        }},
+        // Single elements [x, x], dense enough to both touch & leave gaps
+        {"degenerate", [](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            for (size_t i = 0; i < count; ++i) {
+                const long int point = Uniform(random, 0, static_cast<long int>(count) * 2);
+                intervals.emplace_back(point, point);
+            }
+            return intervals;
+        }},
+        // A few long Intervals with many short ones inside & around them
+        {"nested", [](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            const long int range = static_cast<long int>(count) * 20;
+            for (size_t i = 0; i < count; ++i) {
+                const long int min = Uniform(random, 0, range);
+                intervals.emplace_back(min, min + ((i % 16 == 0) ? Uniform(random, 0, range / 8) : Uniform(random, 0, 10)));
+            }
+            return intervals;
+        }},
+        // Intervals at & reaching the ends of the domain, where any +1 or width computation overflows
+        {"extreme", [lowest, highest](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            for (size_t i = 0; i < count; ++i) {
+                switch (Uniform(random, 0, 5)) {
+                case 0: intervals.emplace_back(lowest, lowest + Uniform(random, 0, 50)); break;
+                case 1: intervals.emplace_back(highest - Uniform(random, 0, 50), highest); break;
+                case 2: intervals.emplace_back(lowest + Uniform(random, 0, 100), lowest + Uniform(random, 0, 100)); break;
+                case 3: intervals.emplace_back(highest - Uniform(random, 0, 100), highest - Uniform(random, 0, 100)); break;
+                case 4: intervals.emplace_back(Uniform(random, -100, 100), Uniform(random, -100, 100)); break;
+                default: intervals.emplace_back(Uniform(random, lowest, highest), Uniform(random, lowest, highest)); break;
+                }
+            }
+            if (Uniform(random, 0, 3) == 0) {
+                intervals.emplace_back(lowest, highest);
+            }
+            return intervals;
+        }},
+        // Spread over the whole domain, nothing touches
+        {"sparse", [lowest, highest](Random &random, size_t count) {
+            std::vector<Interval> intervals;
+            for (size_t i = 0; i < count; ++i) {
+                const long int min = Uniform(random, lowest, highest - 1000);
+                intervals.emplace_back(min, min + Uniform(random, 0, 1000));
+            }
+            return intervals;
+        }},
+    };
+}
+
+// Targets for a collection: random ones around its Intervals plus the edge cases at each of them
+std::vector<Interval> Targets(Random &random, const std::vector<Interval> &intervals, size_t count) {
+    const long int lowest = std::numeric_limits<long int>::min();
+    const long int highest = std::numeric_limits<long int>::max();
+    std::vector<Interval> targets;
+
+    for (const Interval &interval : intervals) {
+        const long int min = interval.Min();
+        const long int max = interval.Max();
+        const long int before = (min > lowest) ? min - 1 : min;
+        const long int after = (max < highest) ? max + 1 : max;
+
+        targets.emplace_back(min, max);
+        targets.emplace_back(min, min);
+        targets.emplace_back(max, max);
+        targets.emplace_back(before, max);
+        targets.emplace_back(min, after);
+        targets.emplace_back(before, before);
+        targets.emplace_back(after, after);
+    }
+
+    for (size_t i = 0; i < count && !intervals.empty(); ++i) {
+        const Interval &from = intervals[random() % intervals.size()];
+        const Interval &to = intervals[random() % intervals.size()];
+        targets.emplace_back(from.Min() + Uniform(random, -2, 2) * (from.Min() > lowest + 2 && from.Min() < highest - 2),
+                             to.Max() + Uniform(random, -2, 2) * (to.Max() > lowest + 2 && to.Max() < highest - 2));
+    }
+
+    targets.emplace_back(lowest, lowest);
+    targets.emplace_back(highest, highest);
+    targets.emplace_back(lowest, highest);
+    return targets;
+}
+
+// Maps closed long Intervals onto a domain: the bounds are kept for long, halved for double (so touching & gapped
+// ends stay apart by a fraction) with the ends of the long domain going to the ends of the double one
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> InDomain(const std::vector<Interval> &intervals) {
+    const auto value = [](long int bound) -> T {
+        if constexpr (std::is_integral_v<T>) {
+            return bound;
+        }
+        else if (bound == std::numeric_limits<long int>::min()) {
+            return std::numeric_limits<T>::lowest();
+        }
+        else if (bound == std::numeric_limits<long int>::max()) {
+            return std::numeric_limits<T>::max();
+        }
+        else {
+            return static_cast<T>(bound) * T(0.5);
+        }
+    };
+
+    std::vector<BasicInterval<T, Boundary>> mapped;
+    for (const Interval &interval : intervals) {
+        mapped.emplace_back(value(interval.Min()), value(interval.Max()));
+    }
+    return mapped;
+}
+
+// Checks of one domain: every backend it supports against the reference & EndpointIndex against a brute force search
+struct Tally {
+    size_t checked = 0;
+    size_t failures = 0;
+
+    void Check(bool matches, const char *what, const char *name, const char *distribution, size_t seed, double min, double max) {
+        ++checked;
+        if (!matches && ++failures <= 20) {
+            std::printf("MISMATCH %s %s on %s seed %zu: [%g, %g]\n", what, name, distribution, seed, min, max);
+        }
+    }
+
+    // For the checks that aren't about a single target
+    void Check(bool matches, const char *what, const char *detail) {
+        ++checked;
+        if (!matches && ++failures <= 20) {
+            std::printf("MISMATCH %s: %s\n", what, detail);
+        }
+    }
+
+    void Add(const Tally &other) {
+        checked += other.checked;
+        failures += other.failures;
+    }
+};
+
+template <typename T, typename Boundary>
+void CheckEndpoints(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals,
+                    const std::vector<BasicInterval<T, Boundary>> &targets) {
+    const BasicEndpointIndex<T, Boundary> index(intervals);
+    const size_t none = BasicEndpointIndex<T, Boundary>::noInterval;
+
+    std::vector<T> points;
+    for (const BasicInterval<T, Boundary> &target : targets) {
+        points.push_back(target.Min());
+        points.push_back(target.Max());
+    }
+
+    std::vector<size_t> before(points.size());
+    std::vector<size_t> after(points.size());
+    index.LastEndingBefore(points.data(), points.size(), before.data());
+    index.FirstStartingAfter(points.data(), points.size(), after.data());
+
+    for (size_t p = 0; p < points.size(); ++p) {
+        // Greatest max ending before the point (the latest on ties), least min starting after it (the earliest on ties)
+        const T point = points[p];
+        size_t expectedBefore = none;
+        size_t expectedAfter = none;
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            const BasicInterval<T, Boundary> &interval = intervals[i];
+            if (interval.IsEmpty()) {
+                continue;
+            }
+
+            const bool endsBefore = Boundary::includesMax ? interval.Max() < point : interval.Max() <= point;
+            const bool startsAfter = Boundary::includesMin ? point < interval.Min() : point <= interval.Min();
+            if (endsBefore && (expectedBefore == none || intervals[expectedBefore].Max() <= interval.Max())) {
+                expectedBefore = i;
+            }
+            if (startsAfter && (expectedAfter == none || interval.Min() < intervals[expectedAfter].Min())) {
+                expectedAfter = i;
+            }
+        }
+
+        const double at = static_cast<double>(point);
+        tally.Check(index.LastEndingBefore(point) == expectedBefore && before[p] == expectedBefore, "LastEndingBefore", "endpoint",
+                    distribution, seed, at, at);
+        tally.Check(index.FirstStartingAfter(point) == expectedAfter && after[p] == expectedAfter, "FirstStartingAfter", "endpoint",
+                    distribution, seed, at, at);
+    }
+}
+
+// ContainsPoints & TryContainsPoints against ContainsPoint, which is checked against the Intervals one by one - the
+// points given in order (merge-joined) & shuffled (binary searched, 4 at a time with AVX2), with the order told &
+// left for it to find out
+template <typename T, typename Boundary>
+void CheckContainsPoints(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals,
+                         const std::vector<BasicInterval<T, Boundary>> &targets) {
+    const BasicCoverageIndex<T, Boundary> index(intervals);
+
+    std::vector<T> points;
+    for (const BasicInterval<T, Boundary> &target : targets) {
+        points.push_back(target.Min());
+        points.push_back(target.Max());
+    }
+    std::vector<T> sorted(points);
+    std::sort(sorted.begin(), sorted.end());
+
+    const auto check = [&](const std::vector<T> &given, PointOrder order, const char *what) {
+        const std::vector<std::uint64_t> bitmap = index.ContainsPoints(given.data(), given.size(), order);
+        std::vector<std::uint64_t> buffer((given.size() + 63) / 64, ~std::uint64_t(0));
+        const bool tried = index.TryContainsPoints(given.data(), given.size(), buffer.data(), order) == IntervalErrc::Ok;
+
+        for (size_t i = 0; i < given.size(); ++i) {
+            const bool expected = index.ContainsPoint(given[i]);
+            const bool covered = (bitmap[i / 64] >> (i % 64)) & 1;
+            const bool triedCovered = (buffer[i / 64] >> (i % 64)) & 1;
+            const double at = static_cast<double>(given[i]);
+            tally.Check(covered == expected && tried && triedCovered == expected, what, "points", distribution, seed, at, at);
+        }
+    };
+
+    for (const T point : points) {
+        bool expected = false;
+        for (const BasicInterval<T, Boundary> &interval : intervals) {
+            expected = expected || (!interval.IsEmpty() && Boundary::Contains(interval.Min(), interval.Max(), point));
+        }
+        const IntervalExpected<bool> tried = index.TryContainsPoint(point);
+        const double at = static_cast<double>(point);
+        tally.Check(index.ContainsPoint(point) == expected && tried && *tried == expected, "ContainsPoint", "points", distribution,
+                    seed, at, at);
+    }
+
+    check(sorted, PointOrder::Sorted, "ContainsPoints Sorted");
+    check(sorted, PointOrder::Unknown, "ContainsPoints Unknown");
+    check(points, PointOrder::Unsorted, "ContainsPoints Unsorted");
+    check(points, PointOrder::Unknown, "ContainsPoints Unknown");
+
+    if constexpr (std::is_floating_point_v<T>) {
+        points.push_back(std::numeric_limits<T>::quiet_NaN());
+        std::vector<std::uint64_t> buffer((points.size() + 63) / 64, 0x5A);
+        tally.Check(index.TryContainsPoints(points.data(), points.size(), buffer.data()) == IntervalErrc::NotANumber &&
+                    std::all_of(buffer.begin(), buffer.end(), [](std::uint64_t word) { return word == 0x5A; }) &&
+                    index.TryContainsPoint(points.back()).Error() == IntervalErrc::NotANumber,
+                    "TryContainsPoints NotANumber", "points", distribution, seed, 0.0, 0.0);
+    }
+}
+
+// SortAndMergeWithinBudget & BasicCoverageIndex::Build against MergeIntervals, on the collection padded with 256 sparse
+// Intervals (so it's cut into several runs & losing or repeating any Interval changes the result) in chunks of 16
+// * Budgets of no Intervals (OverBudget), a few (may not fit), half as many again as the input (has to spill) &
+//   plenty (fits in memory) - spilling into a directory that doesn't exist tells which of them spilled
+// * Progress has to go through every chunk of the sort & then of the merge, in order, & cancelling (up front or from
+//   the progress callback) has to stop the build at the next chunk
+template <typename T, typename Boundary>
+void CheckBudgetedBuild(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    Random random(seed);
+    std::vector<IntervalType> padded = InDomain<T, Boundary>(Distributions().back().make(random, 256));
+    padded.insert(padded.end(), intervals.begin(), intervals.end());
+    std::shuffle(padded.begin(), padded.end(), random);
+    const size_t count = padded.size();
+
+    std::vector<IntervalType> sorted(padded);
+    std::sort(sorted.begin(), sorted.end());
+    const std::vector<IntervalType> expected = MergeIntervals(sorted);
+
+    const auto build = [&](size_t budget, const char *directory, std::vector<IntervalType> &merged) {
+        BuildOptions options;
+        options.memoryBudget = budget * sizeof(IntervalType);
+        options.spillDirectory = directory;
+        options.chunkSize = 16;
+        return SortAndMergeWithinBudget(padded.data(), count, options, merged);
+    };
+    const char *missing = "/nonexistent-conformance-spill-directory";
+
+    for (const size_t budget : {size_t(0), size_t(16), size_t(64), count + count / 2, 4 * count + 1024}) {
+        std::vector<IntervalType> merged, unspilled;
+        const IntervalErrc error = build(budget, "", merged);
+        const IntervalErrc spillError = build(budget, missing, unspilled);
+        const double at = static_cast<double>(budget);
+
+        tally.Check((error == IntervalErrc::Ok && merged == expected) || (error == IntervalErrc::OverBudget && budget < count),
+                    "SortAndMergeWithinBudget", "budget", distribution, seed, at, at);
+        tally.Check(spillError == error || (spillError == IntervalErrc::SpillFailed && budget < 2 * count), "SpillFailed", "budget",
+                    distribution, seed, at, at);
+
+        if (budget == 0) {
+            tally.Check(error == IntervalErrc::OverBudget, "OverBudget", "budget", distribution, seed, at, at);
+        }
+        else if (budget == count + count / 2) {
+            tally.Check(error == IntervalErrc::Ok && spillError == IntervalErrc::SpillFailed, "spill", "budget", distribution, seed,
+                        at, at);
+        }
+        else if (budget > 4 * count) {
+            tally.Check(error == IntervalErrc::Ok && spillError == IntervalErrc::Ok, "in memory", "budget", distribution, seed, at, at);
+        }
+
+        BuildOptions options;
+        options.memoryBudget = budget * sizeof(IntervalType);
+        const IntervalExpected<BasicCoverageIndex<T, Boundary>> index = BasicCoverageIndex<T, Boundary>::Build(padded, options);
+        tally.Check(index ? (index->Intervals() == expected && index->InputCount() == count) : index.Error() == error,
+                    "Build(options)", "budget", distribution, seed, at, at);
+    }
+
+    // Progress, spilled & in memory
+    for (const size_t budget : {count + count / 2, 4 * count + 1024}) {
+        std::vector<std::tuple<BuildPhase, size_t, size_t>> calls;
+        BuildOptions options;
+        options.memoryBudget = budget * sizeof(IntervalType);
+        options.chunkSize = 16;
+        options.progress = [&calls](BuildPhase phase, size_t done, size_t total) { calls.emplace_back(phase, done, total); };
+
+        std::vector<IntervalType> merged;
+        const IntervalErrc error = SortAndMergeWithinBudget(padded.data(), count, options, merged);
+
+        bool ordered = !calls.empty() && calls.front() == std::make_tuple(BuildPhase::Sort, size_t(0), count)
+                    && calls.back() == std::make_tuple(BuildPhase::Merge, count, count);
+        size_t merges = 0;
+        for (size_t i = 1; ordered && i < calls.size(); ++i) {
+            const auto &[phase, done, total] = calls[i];
+            const auto &[previousPhase, previousDone, previousTotal] = calls[i - 1];
+            ordered = total == count && done <= count && (phase == previousPhase ? previousDone <= done : phase == BuildPhase::Merge);
+            merges += phase == BuildPhase::Merge;
+        }
+        const double at = static_cast<double>(budget);
+        tally.Check(error == IntervalErrc::Ok && ordered && merges >= count / 16, "progress", "budget", distribution, seed, at, at);
+
+        // Cancelled from the progress callback part way through, no more chunks are done after that
+        const size_t cancelAt = 1 + seed % (calls.size() - 1);
+        CancellationToken token;
+        size_t made = 0;
+        options.cancellation = &token;
+        options.progress = [&](BuildPhase, size_t, size_t) {
+            if (++made == cancelAt) {
+                token.Cancel();
+            }
+        };
+        tally.Check(SortAndMergeWithinBudget(padded.data(), count, options, merged) == IntervalErrc::Cancelled && made == cancelAt,
+                    "CancellationToken", "budget", distribution, seed, at, at);
+
+        // Cancelled before it starts
+        options.progress = nullptr;
+        const IntervalExpected<BasicCoverageIndex<T, Boundary>> index = BasicCoverageIndex<T, Boundary>::Build(padded, options);
+        tally.Check(!index && index.Error() == IntervalErrc::Cancelled, "Build(options) cancelled", "budget", distribution, seed, at,
+                    at);
+    }
+}
+
+// Footprint() of the structures the collection goes into: parts adding up to Total(), the boundaries counting exactly
+// the ends kept, the input & merged counts & CompressionRatio() the ratio of them
+template <typename T, typename Boundary>
+void CheckFootprint(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    std::vector<IntervalType> sorted(intervals);
+    std::sort(sorted.begin(), sorted.end());
+    const size_t merged = MergeIntervals(sorted).size();
+    const size_t count = intervals.size();
+    const double ratio = merged ? static_cast<double>(count) / static_cast<double>(merged) : 1.0;
+
+    const auto check = [&](const MemoryFootprint &footprint, size_t inputCount, size_t mergedCount, size_t boundaries, const char *what) {
+        tally.Check(footprint.Total() == footprint.boundaries + footprint.searchLayout + footprint.auxiliary + footprint.slack &&
+                    footprint.boundaries == boundaries && footprint.inputCount == inputCount && footprint.mergedCount == mergedCount &&
+                    footprint.CompressionRatio() == (mergedCount ? static_cast<double>(inputCount) / static_cast<double>(mergedCount) : 1.0),
+                    what, "footprint", distribution, seed, static_cast<double>(count), static_cast<double>(merged));
+    };
+
+    BasicCoverageIndex<T, Boundary> index(intervals);
+    const MemoryFootprint plain = index.Footprint();
+    check(plain, count, merged, merged * sizeof(IntervalType), "BasicCoverageIndex");
+    tally.Check(plain.searchLayout == 0 && plain.auxiliary == 0 && plain.CompressionRatio() == ratio, "BasicCoverageIndex parts",
+                "footprint", distribution, seed, static_cast<double>(count), static_cast<double>(merged));
+
+    // The cached endpoints & heatmap are counted as auxiliary, on top of the merged Intervals
+    const BasicEndpointIndex<T, Boundary> &endpoints = index.CacheEndpoints(intervals);
+    const size_t nonEmpty = static_cast<size_t>(std::count_if(intervals.begin(), intervals.end(),
+                                                              [](const IntervalType &interval) { return !interval.IsEmpty(); }));
+    const MemoryFootprint endpointsFootprint = endpoints.Footprint();
+    check(endpointsFootprint, count, count, 2 * nonEmpty * sizeof(T), "BasicEndpointIndex");
+    check(index.Footprint(), count, merged, merged * sizeof(IntervalType), "BasicCoverageIndex endpoints");
+    tally.Check(index.Footprint().Total() == plain.Total() + endpointsFootprint.Total(), "BasicCoverageIndex endpoints total", "footprint",
+                distribution, seed, static_cast<double>(count), static_cast<double>(merged));
+
+    BuildOptions options;
+    options.heatmapBuckets = 16;
+    const IntervalExpected<BasicCoverageIndex<T, Boundary>> withHeatmap = BasicCoverageIndex<T, Boundary>::Build(intervals, options);
+    if (withHeatmap) {
+        const MemoryFootprint footprint = withHeatmap->Footprint();
+        check(footprint, count, merged, merged * sizeof(IntervalType), "BasicCoverageIndex heatmap");
+        tally.Check(footprint.auxiliary == (merged ? 2 * options.heatmapBuckets * sizeof(double) : 0), "BasicCoverageIndex heatmap parts",
+                    "footprint", distribution, seed, static_cast<double>(count), static_cast<double>(merged));
+    }
+
+    if constexpr (std::is_integral_v<T>) {
+        const BasicBlockCoverageIndex<T, Boundary, std::uint32_t> blocks(intervals);
+        check(blocks.Footprint(), count, merged, merged * (sizeof(std::uint32_t) + sizeof(T)), "BasicBlockCoverageIndex");
+    }
+
+    // The sets count every Insert of a non-empty Interval as an input
+    BasicConcurrentIntervalSet<T, Boundary> concurrent;
+    BasicSeqlockIntervalSet<T, Boundary, 1024> seqlock;
+    for (const IntervalType &interval : intervals) {
+        concurrent.Insert(interval);
+        seqlock.Insert(interval);
+    }
+    check(concurrent.Footprint(), nonEmpty, merged, merged * 2 * sizeof(T), "BasicConcurrentIntervalSet");
+    const MemoryFootprint stored = seqlock.Footprint();
+    check(stored, nonEmpty, merged, merged * 2 * sizeof(std::atomic<T>), "BasicSeqlockIntervalSet");
+    tally.Check(stored.boundaries + stored.slack == 1024 * 2 * sizeof(std::atomic<T>), "BasicSeqlockIntervalSet capacity", "footprint",
+                distribution, seed, static_cast<double>(count), static_cast<double>(merged));
+}
+
+// Where a heatmap puts the Interval: integral ones span [first element, last element + 1) - the elements found before
+// converting, as adding 1 to a large double may round away
+template <typename T, typename Boundary>
+std::pair<double, double> HeatmapSpan(const BasicInterval<T, Boundary> &interval) {
+    if constexpr (std::is_integral_v<T>) {
+        return {static_cast<double>(Boundary::includesMin ? interval.Min() : interval.Min() + 1),
+                static_cast<double>(Boundary::includesMax ? interval.Max() : interval.Max() - 1) + 1.0};
+    }
+    else {
+        return {static_cast<double>(interval.Min()), static_cast<double>(interval.Max())};
+    }
+}
+
+// The depth of every bucket summed up the slow way, each Interval against each bucket
+// * In units of buckets from min, as bucket bounds computed in the domain would round together for ranges only a few
+//   ulps wide
+template <typename T, typename Boundary>
+std::vector<double> ReferenceHeatmapDepth(const std::vector<BasicInterval<T, Boundary>> &intervals, double min, double max,
+                                          size_t buckets) {
+    const double scale = static_cast<double>(buckets) / (max - min);
+    std::vector<double> depth(buckets, 0.0);
+
+    for (const BasicInterval<T, Boundary> &interval : intervals) {
+        if (interval.IsEmpty()) {
+            continue;
+        }
+
+        auto [from, to] = HeatmapSpan(interval);
+        from = (std::clamp(from, min, max) - min) * scale;
+        to = (std::clamp(to, min, max) - min) * scale;
+        for (size_t bucket = 0; bucket < buckets; ++bucket) {
+            const double low = static_cast<double>(bucket);
+            depth[bucket] += std::max(0.0, std::min(to, low + 1.0) - std::max(from, low));
+        }
+    }
+    return depth;
+}
+
+bool NearlyEqual(const std::vector<double> &lhs, const std::vector<double> &rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (std::abs(lhs[i] - rhs[i]) > 1e-9 * std::max(1.0, std::abs(rhs[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// BuildCoverageHeatmap over the span of the collection & over a range cutting into it, against the brute force depth of
+// the Intervals & of them merged, & the heatmap Build(options) caches against it
+// * An empty range or no buckets are rejected
+template <typename T, typename Boundary>
+void CheckHeatmap(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    std::vector<IntervalType> sorted(intervals);
+    std::sort(sorted.begin(), sorted.end());
+    const std::vector<IntervalType> merged = MergeIntervals(sorted);
+    const size_t buckets = 1 + seed % 7;
+
+    BuildOptions options;
+    options.heatmapBuckets = buckets;
+    const IntervalExpected<BasicCoverageIndex<T, Boundary>> index = BasicCoverageIndex<T, Boundary>::Build(intervals, options);
+    if (merged.empty()) {
+        tally.Check(index && index->Heatmap() == nullptr, "Heatmap() of nothing", "heatmap", distribution, seed, 0.0, 0.0);
+        return;
+    }
+
+    const IntervalType span = IntervalType::FromOrdered(merged.front().Min(), merged.back().Max());
+    const IntervalType middle = IntervalType::FromOrdered(merged.front().Min() / 2 + merged.back().Min() / 2, merged.back().Max());
+    for (const IntervalType &range : {span, middle}) {
+        if (range.IsEmpty()) {
+            continue;
+        }
+
+        const auto [min, max] = HeatmapSpan(range);
+
+        const CoverageHeatmap heatmap = BuildCoverageHeatmap(intervals, merged, range, buckets, 1);
+        tally.Check(heatmap.min == min && heatmap.max == max && NearlyEqual(heatmap.depth, ReferenceHeatmapDepth(intervals, min, max, buckets))
+                    && NearlyEqual(heatmap.coverage, ReferenceHeatmapDepth(merged, min, max, buckets)), "BuildCoverageHeatmap", "heatmap",
+                    distribution, seed, min, max);
+
+        if (range == span) {
+            const CoverageHeatmap *cached = index ? index->Heatmap() : nullptr;
+            tally.Check(cached && cached->min == heatmap.min && cached->max == heatmap.max && cached->depth == heatmap.depth &&
+                        cached->coverage == heatmap.coverage, "Heatmap()", "heatmap", distribution, seed, min, max);
+        }
+    }
+
+    bool rejected = false;
+    try {
+        BuildCoverageHeatmap(intervals, merged, span, 0);
+    }
+    catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    tally.Check(rejected, "BuildCoverageHeatmap no buckets", "heatmap", distribution, seed, 0.0, 0.0);
+}
+
+// The exception-free API against the throwing one: TryMergeIntervals (Unsorted on input out of order), Make &
+// TrySetMax (MaxBelowMin, NotANumber, leaving the Interval unchanged)
+template <typename T, typename Boundary>
+void CheckErrors(Tally &tally, const char *distribution, size_t seed, const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    std::vector<IntervalType> sorted(intervals);
+    std::sort(sorted.begin(), sorted.end());
+    const std::vector<IntervalType> merged = MergeIntervals(sorted);
+
+    std::vector<IntervalType> inPlace(sorted);
+    tally.Check(TryMergeIntervals(inPlace) == IntervalErrc::Ok && inPlace == merged, "TryMergeIntervals", "errors", distribution,
+                seed, 0.0, 0.0);
+
+    const bool isSorted = std::is_sorted(intervals.begin(), intervals.end());
+    std::vector<IntervalType> asGiven(intervals);
+    tally.Check(TryMergeIntervals(asGiven) == (isSorted ? IntervalErrc::Ok : IntervalErrc::Unsorted), "TryMergeIntervals Unsorted",
+                "errors", distribution, seed, 0.0, 0.0);
+
+    for (const IntervalType &interval : intervals) {
+        const T min = interval.Min();
+        const T max = interval.Max();
+        const double at = static_cast<double>(min), to = static_cast<double>(max);
+
+        const IntervalExpected<IntervalType> made = IntervalType::Make(min, max);
+        const IntervalExpected<IntervalType> swapped = IntervalType::Make(max, min);
+        tally.Check(made && *made == interval && swapped && *swapped == interval, "Make", "errors", distribution, seed, at, to);
+
+        IntervalType changed = interval;
+        tally.Check(changed.TrySetMax(min) == IntervalErrc::Ok && changed.Max() == min, "TrySetMax", "errors", distribution, seed, at, to);
+
+        // Anything below min, where there is something below it
+        if (min > std::numeric_limits<T>::lowest()) {
+            T below = min - 1;
+            if constexpr (std::is_floating_point_v<T>) {
+                below = std::nextafter(min, std::numeric_limits<T>::lowest());
+            }
+            IntervalType unchanged = interval;
+            bool threw = false;
+            try {
+                unchanged.SetMax(below);
+            }
+            catch (const std::invalid_argument &) {
+                threw = true;
+            }
+            tally.Check(unchanged.TrySetMax(below) == IntervalErrc::MaxBelowMin && unchanged == interval && threw,
+                        "TrySetMax MaxBelowMin", "errors", distribution, seed, at, to);
+        }
+
+        if constexpr (std::is_floating_point_v<T>) {
+            const T nan = std::numeric_limits<T>::quiet_NaN();
+            IntervalType unchanged = interval;
+            tally.Check(unchanged.TrySetMax(nan) == IntervalErrc::NotANumber && unchanged == interval, "TrySetMax NotANumber", "errors",
+                        distribution, seed, at, to);
+            tally.Check(IntervalType::Make(nan, max).Error() == IntervalErrc::NotANumber &&
+                        IntervalType::Make(min, nan).Error() == IntervalErrc::NotANumber, "Make NotANumber", "errors", distribution,
+                        seed, at, to);
+        }
+    }
+}
+
+template <typename T, typename Boundary>
+Tally CheckDomain(const char *domain, size_t seeds) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    const std::vector<Backend<IntervalType>> backends = Backends<T, Boundary>();
+    Tally tally;
+
+    for (const Distribution &distribution : Distributions()) {
+        for (size_t seed = 0; seed < seeds; ++seed) {
+            Random random(seed);
+            const std::vector<Interval> raw = distribution.make(random, 1 + seed % 60);
+            const std::vector<IntervalType> intervals = InDomain<T, Boundary>(raw);
+            const std::vector<IntervalType> targets = InDomain<T, Boundary>(Targets(random, raw, 50));
+
+            std::vector<bool> expected;
+            for (const IntervalType &target : targets) {
+                expected.push_back(ReferenceIsIntervalInUnionOfOthers(target, intervals));
+            }
+
+            for (const Backend<IntervalType> &backend : backends) {
+                Built<IntervalType> built;
+                try {
+                    built = backend.build(intervals);
+                }
+                catch (const std::length_error &) {
+                    continue;
+                }
+
+                std::vector<IntervalType> kept;
+                for (size_t i = 0; backend.keeps && i < intervals.size(); ++i) {
+                    if (backend.keeps(i)) {
+                        kept.push_back(intervals[i]);
+                    }
+                }
+
+                for (size_t i = 0; i < targets.size(); ++i) {
+                    const bool reference = backend.keeps ? ReferenceIsIntervalInUnionOfOthers(targets[i], kept) : expected[i];
+                    tally.Check(built.contains(targets[i]) == reference, domain, backend.name, distribution.name, seed,
+                                static_cast<double>(targets[i].Min()), static_cast<double>(targets[i].Max()));
+                }
+            }
+
+            CheckEndpoints(tally, distribution.name, seed, intervals, targets);
+            CheckContainsPoints(tally, distribution.name, seed, intervals, targets);
+            CheckErrors(tally, distribution.name, seed, intervals);
+            CheckBudgetedBuild(tally, distribution.name, seed, intervals);
+            CheckFootprint(tally, distribution.name, seed, intervals);
+            CheckHeatmap(tally, distribution.name, seed, intervals);
+        }
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", domain, tally.checked, tally.failures);
+    return tally;
+}
+
+// Boxes in D dimensions, as their closed Interval on each axis
+template <size_t Dimensions>
+using Axes = std::array<Interval, Dimensions>;
+
+// Interval has no default, so arrays of them start out filled with one
+template <size_t Dimensions>
+Axes<Dimensions> Filled(const Interval &interval) {
+    return [&interval]<size_t... Axis>(std::index_sequence<Axis...>) {
+        return Axes<Dimensions>{(static_cast<void>(Axis), interval)...};
+    }(std::make_index_sequence<Dimensions>());
+}
+
+// The box is covered if every elementary cell of it is - the cells being what's left between the ends of the boxes
+// cutting through it, each either wholly inside a box or wholly outside of it, so one corner of each decides
+template <size_t Dimensions>
+bool ReferenceIsBoxInUnionOfOthers(const Axes<Dimensions> &box, const std::vector<Axes<Dimensions>> &boxes) {
+    std::array<std::vector<long int>, Dimensions> cuts;
+    for (size_t axis = 0; axis < Dimensions; ++axis) {
+        cuts[axis].push_back(box[axis].Min());
+        for (const Axes<Dimensions> &other : boxes) {
+            if (box[axis].Min() < other[axis].Min() && other[axis].Min() <= box[axis].Max()) {
+                cuts[axis].push_back(other[axis].Min());
+            }
+            if (box[axis].Min() <= other[axis].Max() && other[axis].Max() < box[axis].Max()) {
+                cuts[axis].push_back(other[axis].Max() + 1);
+            }
+        }
+        std::sort(cuts[axis].begin(), cuts[axis].end());
+        cuts[axis].erase(std::unique(cuts[axis].begin(), cuts[axis].end()), cuts[axis].end());
+    }
+
+    std::array<size_t, Dimensions> cell{};
+    for (;;) {
+        bool covered = false;
+        for (const Axes<Dimensions> &other : boxes) {
+            bool inside = true;
+            for (size_t axis = 0; axis < Dimensions && inside; ++axis) {
+                const long int corner = cuts[axis][cell[axis]];
+                inside = other[axis].Min() <= corner && corner <= other[axis].Max();
+            }
+            if (inside) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            return false;
+        }
+
+        size_t axis = 0;
+        while (axis < Dimensions && ++cell[axis] == cuts[axis].size()) {
+            cell[axis++] = 0;
+        }
+        if (axis == Dimensions) {
+            return true;
+        }
+    }
+}
+
+// A few boxes, in a small space so they overlap, tile (touching at + 1) & leave gaps - or at the ends of the domain
+template <size_t Dimensions>
+std::vector<Axes<Dimensions>> RandomBoxes(Random &random, size_t count, int kind) {
+    const long int lowest = std::numeric_limits<long int>::min();
+    const long int highest = std::numeric_limits<long int>::max();
+    std::vector<Axes<Dimensions>> boxes;
+
+    for (size_t i = 0; i < count; ++i) {
+        Axes<Dimensions> box = Filled<Dimensions>(Interval(0, 0));
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            if (kind == 0) {
+                const long int min = Uniform(random, 0, 24);
+                box[axis] = Interval(min, min + Uniform(random, 0, 8));
+            }
+            else if (kind == 1) {
+                // Tiles of 4, so neighbours touch
+                const long int tile = Uniform(random, 0, 4) * 4;
+                box[axis] = Interval(tile, tile + 3 + 4 * Uniform(random, 0, 1));
+            }
+            else {
+                switch (Uniform(random, 0, 2)) {
+                case 0: box[axis] = Interval(lowest, lowest + Uniform(random, 0, 6)); break;
+                case 1: box[axis] = Interval(highest - Uniform(random, 0, 6), highest); break;
+                default: box[axis] = Interval(lowest, highest); break;
+                }
+            }
+        }
+        boxes.push_back(box);
+    }
+    return boxes;
+}
+
+// The boxes themselves, grown by one element, the bounding box of random pairs & the whole domain
+template <size_t Dimensions>
+std::vector<Axes<Dimensions>> BoxTargets(Random &random, const std::vector<Axes<Dimensions>> &boxes) {
+    const long int lowest = std::numeric_limits<long int>::min();
+    const long int highest = std::numeric_limits<long int>::max();
+    std::vector<Axes<Dimensions>> targets;
+
+    for (const Axes<Dimensions> &box : boxes) {
+        targets.push_back(box);
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            Axes<Dimensions> grown = box;
+            grown[axis] = Interval((box[axis].Min() > lowest) ? box[axis].Min() - 1 : lowest,
+                                   (box[axis].Max() < highest) ? box[axis].Max() + 1 : highest);
+            targets.push_back(grown);
+        }
+    }
+
+    for (size_t i = 0; i < 2 * boxes.size(); ++i) {
+        const Axes<Dimensions> &first = boxes[random() % boxes.size()];
+        const Axes<Dimensions> &second = boxes[random() % boxes.size()];
+        Axes<Dimensions> target = first;
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            target[axis] = Interval(std::min(first[axis].Min(), second[axis].Min()), std::max(first[axis].Max(), second[axis].Max()));
+        }
+        targets.push_back(target);
+    }
+
+    targets.push_back(Filled<Dimensions>(Interval(lowest, highest)));
+    return targets;
+}
+
+template <size_t Dimensions>
+Tally CheckBoxes(const char *name, size_t seeds) {
+    Tally tally;
+    const char *kinds[] = {"random", "tiles", "extreme"};
+
+    for (size_t seed = 0; seed < seeds; ++seed) {
+        Random random(seed);
+        const int kind = static_cast<int>(seed % 3);
+        const std::vector<Axes<Dimensions>> boxes = RandomBoxes<Dimensions>(random, 1 + seed % 10, kind);
+        const std::vector<Axes<Dimensions>> targets = BoxTargets<Dimensions>(random, boxes);
+
+        std::vector<Box<Dimensions>> indexed;
+        std::vector<Rectangle> rectangles;
+        for (const Axes<Dimensions> &box : boxes) {
+            indexed.emplace_back(box);
+            if constexpr (Dimensions == 2) {
+                rectangles.emplace_back(box[0], box[1]);
+            }
+        }
+        const BoxCoverageIndex<Dimensions> index(indexed);
+
+        for (const Axes<Dimensions> &target : targets) {
+            const bool expected = ReferenceIsBoxInUnionOfOthers(target, boxes);
+            tally.Check(index.Contains(Box<Dimensions>(target)) == expected, name, "box", kinds[kind], seed,
+                        static_cast<double>(target[0].Min()), static_cast<double>(target[0].Max()));
+
+            if constexpr (Dimensions == 2) {
+                tally.Check(IsRectangleInUnionOfOthers(Rectangle(target[0], target[1]), rectangles) == expected, name, "rectangle",
+                            kinds[kind], seed, static_cast<double>(target[0].Min()), static_cast<double>(target[0].Max()));
+            }
+        }
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// Runs writer(w) on each of the writers threads, while the readers threads keep calling reader until every writer is
+// done (& once more after that) - each reader counting into a Tally of its own, added up at the end
+Tally Race(size_t writers, size_t readers, const std::function<void(size_t)> &writer,
+           const std::function<void(Tally&, Random&)> &reader) {
+    std::atomic<size_t> running{writers};
+    std::vector<Tally> tallies(readers);
+    std::vector<std::thread> threads;
+
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            Random random(1000 + r);
+            bool last = false;
+            while (!last) {
+                last = running.load(std::memory_order_acquire) == 0;
+                reader(tallies[r], random);
+
+                // Note: so the writers keep going when there are fewer cores than threads
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (size_t w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            writer(w);
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    Tally tally;
+    for (const Tally &other : tallies) {
+        tally.Add(other);
+    }
+    return tally;
+}
+
+// Intervals for each of the writers of a race, dense ones or sparse ones spread over the domain
+// * The dense ones of all the writers advance through the domain together, so nearly every insert coalesces with the
+//   ones just inserted (by itself & the others, some just touching) - the very ones the readers query most
+std::vector<std::vector<Interval>> WriterInputs(size_t writers, size_t count, bool dense, size_t seed) {
+    std::vector<std::vector<Interval>> inputs(writers);
+    Random random(seed);
+
+    for (std::vector<Interval> &input : inputs) {
+        for (size_t i = 0; i < count; ++i) {
+            const long int min = dense ? 3 * static_cast<long int>(i) + Uniform(random, 0, 12) : Uniform(random, 0, 1000000000L);
+            input.emplace_back(min, min + Uniform(random, 0, dense ? 6 : 1000));
+        }
+    }
+    return inputs;
+}
+
+// Which of the done Intervals of a writer a reader checks, half the time one of the last few (where coalescing inserts
+// are going on)
+size_t PickDone(Random &random, size_t done) {
+    return (random() % 2) ? done - 1 - random() % std::min<size_t>(done, 8) : random() % done;
+}
+
+// A point the (non-empty) Interval holds
+template <typename T, typename Boundary>
+T PointIn(const BasicInterval<T, Boundary> &interval) {
+    if constexpr (Boundary::includesMin) {
+        return interval.Min();
+    }
+    else if constexpr (Boundary::includesMax) {
+        return interval.Max();
+    }
+    else {
+        return interval.Min() + (interval.Max() - interval.Min()) / 2;
+    }
+}
+
+// All of the writers' Intervals sorted & merged, what the set has to hold once they're done
+template <typename IntervalType>
+std::vector<IntervalType> MergedInputs(const std::vector<std::vector<IntervalType>> &inputs) {
+    std::vector<IntervalType> all;
+    for (const std::vector<IntervalType> &input : inputs) {
+        all.insert(all.end(), input.begin(), input.end());
+    }
+    std::sort(all.begin(), all.end());
+    return MergeIntervals(all);
+}
+
+// Writers inserting into a BasicConcurrentIntervalSet while readers query it
+// * Each writer publishes how many of its Intervals it has inserted, readers check that every one of those is covered
+//   (an Insert is visible once it returns, coalescing or not) - both the Interval & its ends as points
+// * Once the writers are done, the set has to hold exactly the merged union of everything inserted
+template <typename T, typename Boundary>
+Tally CheckConcurrentSet(const char *name, size_t threads, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    Tally tally;
+
+    for (const bool dense : {true, false}) {
+        std::vector<std::vector<IntervalType>> inputs;
+        for (const std::vector<Interval> &input : WriterInputs(threads, count, dense, dense ? 1 : 2)) {
+            inputs.push_back(InDomain<T, Boundary>(input));
+        }
+
+        BasicConcurrentIntervalSet<T, Boundary> set;
+        std::vector<std::atomic<size_t>> inserted(threads);
+
+        const auto writer = [&](size_t w) {
+            for (size_t i = 0; i < inputs[w].size(); ++i) {
+                set.Insert(inputs[w][i]);
+                inserted[w].store(i + 1, std::memory_order_release);
+                if (i % 16 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        };
+        const auto reader = [&](Tally &own, Random &random) {
+            for (size_t w = 0; w < threads; ++w) {
+                const size_t done = inserted[w].load(std::memory_order_acquire);
+                if (done == 0) {
+                    continue;
+                }
+
+                const IntervalType &interval = inputs[w][PickDone(random, done)];
+                own.Check(set.Contains(interval), name, "inserted Interval not covered");
+                if (!interval.IsEmpty()) {
+                    own.Check(set.ContainsPoint(PointIn(interval)), name, "point of an inserted Interval not covered");
+                }
+            }
+        };
+        tally.Add(Race(threads, threads, writer, reader));
+
+        tally.Check(set.Intervals() == MergedInputs(inputs), name, dense ? "dense set differs from merged inputs"
+                                                                         : "sparse set differs from merged inputs");
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// Producers pushing into a BasicIntervalIngestor with a tiny ring (so they keep running into back-pressure) while
+// readers take snapshots of the live set
+// * Producers mix Push & TryPush (falling back to Push when the ring is full), then Flush & check that everything they
+//   pushed is in the live set
+// * A snapshot taken later has to cover every Interval of one taken earlier (the live set only grows), & be merged
+// * Once the producers are done, the live set has to equal MergeIntervals of everything pushed - & after Stop, Flush
+//   has to report what's pushed afterwards as never merged rather than wait for it
+template <typename T, typename Boundary>
+Tally CheckIngestor(const char *name, size_t threads, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    typedef BasicCoverageIndex<T, Boundary> IndexType;
+    Tally tally;
+
+    for (const bool dense : {true, false}) {
+        std::vector<std::vector<IntervalType>> inputs;
+        for (const std::vector<Interval> &input : WriterInputs(threads, count, dense, dense ? 3 : 4)) {
+            inputs.push_back(InDomain<T, Boundary>(input));
+        }
+
+        BasicIntervalIngestor<T, Boundary> ingestor(64, 16);
+        std::vector<Tally> producers(threads);
+
+        const auto producer = [&](size_t w) {
+            for (size_t i = 0; i < inputs[w].size(); ++i) {
+                const bool pushed = (i % 2 == 0 && ingestor.TryPush(inputs[w][i])) || ingestor.Push(inputs[w][i]);
+                producers[w].Check(pushed, name, "Push dropped an Interval while the builder was running");
+            }
+
+            producers[w].Check(ingestor.Flush(), name, "Flush failed while the builder was running");
+            const std::shared_ptr<const IndexType> live = ingestor.Snapshot();
+            for (const IntervalType &interval : inputs[w]) {
+                producers[w].Check(live->Contains(interval), name, "pushed Interval missing after Flush");
+            }
+        };
+        const auto reader = [&](Tally &own, Random &random) {
+            const std::shared_ptr<const IndexType> earlier = ingestor.Snapshot();
+            const std::shared_ptr<const IndexType> later = ingestor.Snapshot();
+            const std::vector<IntervalType> &intervals = earlier->Intervals();
+            if (intervals.empty()) {
+                return;
+            }
+
+            const size_t i = random() % intervals.size();
+            own.Check(later->Contains(intervals[i]), name, "later snapshot lost an Interval");
+            if (i + 1 < intervals.size()) {
+                own.Check(intervals[i].Max() < intervals[i + 1].Min() && !Boundary::Touches(intervals[i].Max(), intervals[i + 1].Min()),
+                          name, "snapshot isn't merged");
+            }
+        };
+        tally.Add(Race(threads, threads, producer, reader));
+        for (const Tally &own : producers) {
+            tally.Add(own);
+        }
+
+        size_t total = 0;
+        for (const std::vector<IntervalType> &input : inputs) {
+            total += input.size();
+        }
+        const IngestStats stats = ingestor.Stats();
+        tally.Check(ingestor.Flush() && stats.pushed == total && stats.merged == total, name, "pushed & merged counts differ");
+        tally.Check(ingestor.Snapshot()->Intervals() == MergedInputs(inputs), name, "live set differs from merged inputs");
+
+        ingestor.Stop();
+        ingestor.Push(inputs[0][0]);
+        ingestor.Push(inputs[0][0]);
+        tally.Check(!ingestor.Flush(), name, "Flush after Stop claims Intervals that are never merged");
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// Writers inserting into a BasicShardedIntervalSet with few shards, so many of the Intervals straddle shards, while
+// readers query it
+// * Readers check that every Insert a writer has finished is visible, the final contents have to equal MergeIntervals
+//   of everything inserted
+// * Every writer also grows a probe across a shard boundary of its own, one Insert at a time ([b - 1 - k, b + k] for
+//   the k-th) - a reader that finds the left part of the probe being inserted covered has to find its right part
+//   covered too, as an Insert updates all the shards it spans under their locks at once
+Tally CheckShardedSet(const char *name, size_t threads, size_t count) {
+    Tally tally;
+    Random inputRandom(5);
+
+    // The Intervals go below half, the probes above it - across the boundaries of the shards there
+    const size_t shards = 8 + 2 * threads;
+    const long int half = 4 * static_cast<long int>(count);
+    const long int width = (2 * half) / static_cast<long int>(shards) + 1;
+    const long int probes = std::min<long int>(static_cast<long int>(count) / 8, width / 2 - 1);
+
+    std::vector<std::vector<Interval>> inputs(threads);
+    for (std::vector<Interval> &input : inputs) {
+        for (size_t i = 0; i < count; ++i) {
+            const long int min = Uniform(inputRandom, 0, half - 1);
+            const long int length = (i % 10 == 0) ? Uniform(inputRandom, 0, half / 4) : Uniform(inputRandom, 0, 6);
+            input.emplace_back(min, std::min(half - 1, min + length));
+        }
+    }
+
+    const auto boundary = [&](size_t w) { return (static_cast<long int>(shards) / 2 + 1 + static_cast<long int>(w)) * width; };
+    const auto probe = [&](size_t w, long int k) { return Interval(boundary(w) - 1 - k, boundary(w) + k); };
+
+    BasicShardedIntervalSet<long int> set(shards, Interval(0, 2 * half));
+    std::vector<std::atomic<size_t>> inserted(threads);
+    std::vector<std::atomic<long int>> probed(threads);
+
+    const auto writer = [&](size_t w) {
+        for (size_t i = 0; i < inputs[w].size(); ++i) {
+            set.Insert(inputs[w][i]);
+            inserted[w].store(i + 1, std::memory_order_release);
+
+            if (i % 8 == 0 && probed[w].load(std::memory_order_relaxed) < probes) {
+                set.Insert(probe(w, probed[w].load(std::memory_order_relaxed)));
+                probed[w].fetch_add(1, std::memory_order_release);
+            }
+            if (i % 16 == 0) {
+                std::this_thread::yield();
+            }
+        }
+    };
+    const auto reader = [&](Tally &own, Random &random) {
+        for (size_t w = 0; w < threads; ++w) {
+            if (const size_t done = inserted[w].load(std::memory_order_acquire)) {
+                own.Check(set.Contains(inputs[w][PickDone(random, done)]), name, "inserted Interval not covered");
+            }
+
+            const long int k = probed[w].load(std::memory_order_acquire);
+            if (k < probes) {
+                const Interval next = probe(w, k);
+                if (set.Contains(Interval(next.Min(), boundary(w) - 1))) {
+                    own.Check(set.Contains(Interval(boundary(w), next.Max())), name, "half of a straddling Insert visible");
+                }
+            }
+        }
+    };
+    tally.Add(Race(threads, threads, writer, reader));
+
+    for (size_t w = 0; w < threads; ++w) {
+        if (probed[w] > 0) {
+            inputs[w].push_back(probe(w, probed[w] - 1));
+        }
+    }
+    tally.Check(set.Intervals() == MergedInputs(inputs), name, "set differs from merged inputs");
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// One writer inserting into a BasicSeqlockIntervalSet while readers query it, so reads keep racing with the writes
+// (& have to retry)
+// * The Intervals lie within cells of 10 elements, the last element of every cell is never inserted - a torn read
+//   (mixing the ends of Intervals before & after an Insert shifted them) would show up as one of those covered
+// * Readers check that every Insert the writer has finished is visible, that Intervals() reads a merged set & that
+//   the never inserted elements aren't covered. The final contents have to equal MergeIntervals of everything inserted
+template <typename T, typename Boundary>
+Tally CheckSeqlockSet(const char *name, size_t threads, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    Tally tally;
+    Random inputRandom(6);
+
+    const long int cells = 150;
+    std::vector<Interval> raw;
+    for (size_t i = 0; i < count; ++i) {
+        const long int cell = 10 * Uniform(inputRandom, 0, cells - 1);
+        const long int from = Uniform(inputRandom, 0, 8);
+        raw.emplace_back(cell + from, cell + Uniform(inputRandom, from, 8));
+    }
+    const std::vector<std::vector<IntervalType>> inputs{InDomain<T, Boundary>(raw)};
+
+    std::vector<IntervalType> gaps;
+    for (long int cell = 0; cell < cells; ++cell) {
+        gaps.push_back(InDomain<T, Boundary>({Interval(10 * cell + 9, 10 * cell + 9)}).front());
+    }
+
+    // The writer clears & refills the set for a number of rounds - it has to be preempted in the middle of an Insert
+    // for a reader to overlap it, which needs it to keep running for a while on a machine with few cores
+    // * Clear bumps the round first, a visibility check only counts if no Clear started while it ran
+    const size_t rounds = 256;
+    BasicSeqlockIntervalSet<T, Boundary, 1024> set;
+    std::atomic<size_t> round{0}, inserted{0};
+
+    const auto writer = [&](size_t) {
+        for (size_t pass = 0; pass < rounds; ++pass) {
+            if (pass > 0) {
+                inserted.store(0, std::memory_order_relaxed);
+                round.store(pass, std::memory_order_release);
+                set.Clear();
+            }
+            for (size_t i = 0; i < inputs[0].size(); ++i) {
+                set.Insert(inputs[0][i]);
+                inserted.store(i + 1, std::memory_order_release);
+            }
+        }
+    };
+    const auto reader = [&](Tally &own, Random &random) {
+        const size_t before = round.load(std::memory_order_acquire);
+        if (const size_t done = inserted.load(std::memory_order_acquire)) {
+            const bool covered = set.Contains(inputs[0][PickDone(random, done)]);
+            if (round.load(std::memory_order_acquire) == before) {
+                own.Check(covered, name, "inserted Interval not covered");
+            }
+        }
+
+        own.Check(!set.ContainsPoint(gaps[random() % gaps.size()].Min()), name, "never inserted element covered");
+
+        const std::vector<IntervalType> intervals = set.Intervals();
+        bool merged = true;
+        for (size_t i = 1; i < intervals.size(); ++i) {
+            merged = merged && intervals[i - 1].Max() < intervals[i].Min() &&
+                     !Boundary::Touches(intervals[i - 1].Max(), intervals[i].Min());
+        }
+        own.Check(merged, name, "Intervals() read a torn set");
+    };
+    tally.Add(Race(1, threads, writer, reader));
+
+    tally.Check(set.Intervals() == MergedInputs(inputs), name, "set differs from merged inputs");
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// The multi-threaded paths only split the work from ~64K Intervals on, so these run on large collections, with 1, 3
+// & 8 threads
+const unsigned largeThreads[] = {1, 3, 8};
+
+// Sorted & merged uniform Intervals, about a third of count once merged
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> LargeMerged(size_t count, size_t seed) {
+    Random random(seed);
+    std::vector<BasicInterval<T, Boundary>> intervals = InDomain<T, Boundary>(Distributions().front().make(random, count));
+    std::sort(intervals.begin(), intervals.end());
+    return MergeIntervals(intervals);
+}
+
+// Union & intersection of two large merged sets, split by merge path - the union against MergeIntervals of both
+// together, the intersection against every pair of overlapping Intervals clipped to each other
+template <typename T, typename Boundary>
+Tally CheckLargeSetOperations(const char *name, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    Tally tally;
+
+    const std::vector<IntervalType> a = LargeMerged<T, Boundary>(count, 7);
+    const std::vector<IntervalType> b = LargeMerged<T, Boundary>(count, 8);
+
+    std::vector<IntervalType> both(a);
+    both.insert(both.end(), b.begin(), b.end());
+    std::sort(both.begin(), both.end());
+    const std::vector<IntervalType> united = MergeIntervals(both);
+
+    // Both sides are sorted by max as well, so the pairs that overlap are found walking them together
+    std::vector<IntervalType> clipped;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        const T min = std::max(a[i].Min(), b[j].Min());
+        const T max = std::min(a[i].Max(), b[j].Max());
+        if (min <= max && !IntervalType::FromOrdered(min, max).IsEmpty()) {
+            clipped.push_back(IntervalType::FromOrdered(min, max));
+        }
+        (a[i].Max() < b[j].Max()) ? ++i : ++j;
+    }
+    const std::vector<IntervalType> intersected = MergeIntervals(clipped);
+
+    for (const unsigned threads : largeThreads) {
+        tally.Check(UnionOfMergedIntervals(a, b, threads) == united, name, "union differs from merging both");
+        tally.Check(IntersectionOfMergedIntervals(a, b, threads) == intersected, name, "intersection differs from the clipped pairs");
+        tally.Check(UnionOfMergedIntervals(b, a, threads) == united, name, "union differs from merging both");
+        tally.Check(IntersectionOfMergedIntervals(b, a, threads) == intersected, name, "intersection differs from the clipped pairs");
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// SortIntervals from radixSortMin on, where it radix sorts, on every distribution - the passes are stable, so the
+// result has to equal std::stable_sort by min exactly (ties included)
+// * Right at the threshold as well as a large collection
+Tally CheckLargeSort(const char *name, size_t count) {
+    Tally tally;
+    const size_t threshold = ActiveDispatchThresholds().radixSortMin;
+
+    for (const Distribution &distribution : Distributions()) {
+        for (const size_t size : {threshold, std::max(count, threshold)}) {
+            Random random(9);
+            std::vector<Interval> intervals = distribution.make(random, size);
+            std::vector<Interval> expected(intervals);
+            std::stable_sort(expected.begin(), expected.end(), [](const Interval &lhs, const Interval &rhs) {
+                return lhs.Min() < rhs.Min();
+            });
+
+            // Same ends in the same order, rather than just both sorted
+            SortIntervals(intervals);
+            bool same = intervals.size() == expected.size();
+            for (size_t i = 0; same && i < intervals.size(); ++i) {
+                same = intervals[i].Min() == expected[i].Min() && intervals[i].Max() == expected[i].Max();
+            }
+            tally.Check(same, name, distribution.name);
+        }
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// A large box index, built with 1, 3 & 8 threads, against the elementary cell reference
+// * The boxes tile a grid of 4 element tiles, with every 8th tile missing & every 16th one twice as wide (overlapping
+//   its neighbour) - random boxes would overlap so much that the tree grows quadratically
+// * The reference only gets the boxes meeting the target, the others can't affect it
+template <size_t Dimensions>
+Tally CheckLargeBoxes(const char *name, size_t count) {
+    Tally tally;
+    Random random(10);
+
+    const long int side = std::max<long int>(2, std::lround(std::pow(static_cast<double>(count), 1.0 / Dimensions)));
+    std::vector<Axes<Dimensions>> boxes;
+    std::vector<Box<Dimensions>> indexed;
+    for (std::array<long int, Dimensions> tile{};;) {
+        if (Uniform(random, 0, 7) != 0) {
+            Axes<Dimensions> box = Filled<Dimensions>(Interval(0, 0));
+            for (size_t axis = 0; axis < Dimensions; ++axis) {
+                box[axis] = Interval(4 * tile[axis], 4 * tile[axis] + 3);
+            }
+            if (Uniform(random, 0, 15) == 0) {
+                box[0] = Interval(box[0].Min(), box[0].Max() + 4);
+            }
+            boxes.push_back(box);
+            indexed.emplace_back(box);
+        }
+
+        size_t axis = 0;
+        while (axis < Dimensions && ++tile[axis] == side) {
+            tile[axis++] = 0;
+        }
+        if (axis == Dimensions) {
+            break;
+        }
+    }
+
+    // A tile & its neighbours, shifted by up to an element at either end, & spans of up to 4 tiles
+    std::vector<Axes<Dimensions>> targets;
+    for (size_t i = 0; i < 1000; ++i) {
+        Axes<Dimensions> target = Filled<Dimensions>(Interval(0, 0));
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            const long int from = Uniform(random, 0, side - 1);
+            const long int to = std::min(side - 1, from + Uniform(random, 0, 3));
+            target[axis] = Interval(4 * from + Uniform(random, -1, 1), 4 * to + 3 + Uniform(random, -1, 1));
+        }
+        targets.push_back(target);
+    }
+    targets.push_back(Filled<Dimensions>(Interval(0, 4 * side - 1)));
+
+    std::vector<bool> expected;
+    for (const Axes<Dimensions> &target : targets) {
+        std::vector<Axes<Dimensions>> meeting;
+        for (const Axes<Dimensions> &box : boxes) {
+            bool meets = true;
+            for (size_t axis = 0; axis < Dimensions && meets; ++axis) {
+                meets = box[axis].Min() <= target[axis].Max() && target[axis].Min() <= box[axis].Max();
+            }
+            if (meets) {
+                meeting.push_back(box);
+            }
+        }
+        expected.push_back(ReferenceIsBoxInUnionOfOthers(target, meeting));
+    }
+
+    size_t nodes = 0;
+    for (const unsigned threads : largeThreads) {
+        const BoxCoverageIndex<Dimensions> index(indexed, threads);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            tally.Check(index.Contains(Box<Dimensions>(targets[i])) == expected[i], name, "box differs from the reference");
+        }
+
+        // The subtrees built on other threads are appended as they are, so the tree has to come out the same
+        tally.Check(nodes == 0 || index.NodeCount() == nodes, name, "node count differs between thread counts");
+        nodes = index.NodeCount();
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// A heatmap of a large collection, split into per-thread chunks with 1, 3 & 8 threads, against the brute force depth
+// of the Intervals & of them merged - over the middle half of their span, so the Intervals at the ends get clipped
+template <typename T, typename Boundary>
+Tally CheckLargeHeatmap(const char *name, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    Tally tally;
+
+    Random random(11);
+    std::vector<IntervalType> intervals = InDomain<T, Boundary>(Distributions().front().make(random, count));
+    std::vector<IntervalType> sorted(intervals);
+    std::sort(sorted.begin(), sorted.end());
+    const std::vector<IntervalType> merged = MergeIntervals(sorted);
+
+    const T span = merged.back().Max() - merged.front().Min();
+    const IntervalType range(merged.front().Min() + span / 4, merged.back().Max() - span / 4);
+    const auto [min, max] = HeatmapSpan(range);
+
+    const size_t buckets = 61;
+    const std::vector<double> depth = ReferenceHeatmapDepth(intervals, min, max, buckets);
+    const std::vector<double> coverage = ReferenceHeatmapDepth(merged, min, max, buckets);
+
+    for (const unsigned threads : largeThreads) {
+        const CoverageHeatmap heatmap = BuildCoverageHeatmap(intervals, merged, range, buckets, threads);
+        tally.Check(heatmap.min == min && heatmap.max == max, name, "heatmap range differs");
+        tally.Check(NearlyEqual(heatmap.depth, depth), name, "depth differs from the brute force count");
+        tally.Check(NearlyEqual(heatmap.coverage, coverage), name, "coverage differs from the brute force count");
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+// The most the budgeted build allocates at once (counted by the replaced operator new) against its budget, which it
+// mustn't exceed whether it fits in memory, spills or gives up with OverBudget - from budgets of a few hundred
+// Intervals, where the bookkeeping of the runs is most of it, up to ones the whole build fits in
+// * The sorting networks are warmed up first, caches kept across builds aren't counted against the budget
+template <typename T, typename Boundary>
+Tally CheckBudgetPeak(const char *name, size_t count) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    Tally tally;
+
+    // Uniform Intervals barely merge, so the small budgets give up - adjacent ones (a tenth as many) merge into chains
+    // that small budgets have to fit, spilling
+    for (const Distribution &distribution : Distributions()) {
+        const bool adjacent = std::string(distribution.name) == "adjacent";
+        if (!adjacent && std::string(distribution.name) != "uniform") {
+            continue;
+        }
+
+        Random random(12);
+        const size_t size = adjacent ? count / 10 : count;
+        const std::vector<IntervalType> intervals = InDomain<T, Boundary>(distribution.make(random, size));
+        std::vector<IntervalType> sorted(intervals);
+        std::sort(sorted.begin(), sorted.end());
+        const std::vector<IntervalType> expected = MergeIntervals(sorted);
+
+        std::vector<IntervalType> warm(intervals.begin(), intervals.begin() + std::min<size_t>(size, 16));
+        SortIntervals(warm);
+
+        for (const size_t budget : {size_t(64), size_t(200), size_t(500), size_t(1000), size_t(2000), size_t(4000), size_t(1) << 14,
+                                    size_t(1) << 16, 4 * size + 1024}) {
+            BuildOptions options;
+            options.memoryBudget = budget * sizeof(IntervalType);
+
+            std::vector<IntervalType> merged;
+            Allocations::live.store(0, std::memory_order_relaxed);
+            Allocations::peak.store(0, std::memory_order_relaxed);
+            Allocations::counting.store(true, std::memory_order_relaxed);
+            const IntervalErrc error = SortAndMergeWithinBudget(intervals.data(), intervals.size(), options, merged);
+            Allocations::counting.store(false, std::memory_order_relaxed);
+            const size_t peak = static_cast<size_t>(Allocations::peak.load(std::memory_order_relaxed));
+
+            char detail[160];
+            std::snprintf(detail, sizeof(detail), "%s, budget of %zu Intervals, %zu bytes at most but %zu allocated (%s)",
+                          distribution.name, budget, options.memoryBudget, peak, IntervalErrorMessage(error));
+            tally.Check(peak <= options.memoryBudget, name, detail);
+            tally.Check((error == IntervalErrc::Ok && merged == expected) || (error == IntervalErrc::OverBudget && budget < 4 * size),
+                        name, detail);
+        }
+    }
+
+    std::printf("%-16s %10zu checks, %zu mismatches\n", name, tally.checked, tally.failures);
+    return tally;
+}
+
+size_t HeapInUse() {
+#if defined(__GLIBC__)
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+struct Measurement {
+    bool skipped = false;
+    double buildSeconds = 0.0;
+    double queriesPerSecond = 0.0;
+    long int heapBytes = 0;
+};
+
+Measurement MeasureBackend(const Backend<Interval> &backend, const std::vector<Interval> &intervals, const std::vector<Interval> &targets) {
+    Measurement measurement;
+
+    const size_t heapBefore = HeapInUse();
+    const Clock::time_point buildStart = Clock::now();
+    Built<Interval> built;
+    try {
+        built = backend.build(intervals);
+    }
+    catch (const std::length_error &) {
+        measurement.skipped = true;
+        return measurement;
+    }
+    measurement.buildSeconds = std::chrono::duration<double>(Clock::now() - buildStart).count();
+    measurement.heapBytes = static_cast<long int>(HeapInUse()) - static_cast<long int>(heapBefore);
+
+    // The slow backends (sorting the whole collection per query) get a fraction of the queries
+    size_t covered = 0;
+    size_t done = 0;
+    const Clock::time_point queryStart = Clock::now();
+    for (const Interval &target : targets) {
+        covered += built.contains(target);
+        ++done;
+        if (done % 64 == 0 && Clock::now() - queryStart > std::chrono::milliseconds(500)) {
+            break;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - queryStart).count();
+    measurement.queriesPerSecond = (seconds > 0.0 && covered <= done) ? static_cast<double>(done) / seconds : 0.0;
+
+    return measurement;
+}
+
+}
+
+int main(int argc, char **argv) {
+    size_t seeds = 200;
+    size_t size = 20000;
+    size_t queries = 20000;
+    size_t threads = 4;
+    size_t large = 1 << 20;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        const size_t value = std::strtoull(argv[i + 1], nullptr, 10);
+        if (option == "--seeds") {
+            seeds = value;
+        }
+        else if (option == "--size") {
+            size = value;
+        }
+        else if (option == "--queries") {
+            queries = value;
+        }
+        else if (option == "--threads") {
+            threads = std::max<size_t>(value, 1);
+        }
+        else if (option == "--large") {
+            large = value;
+        }
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    // Conformance
+    std::printf("Conformance:\n");
+    size_t failures = 0;
+    failures += CheckDomain<long int, Closed>("long closed", seeds).failures;
+    failures += CheckDomain<long int, HalfOpen>("long half-open", seeds).failures;
+    failures += CheckDomain<long int, Open>("long open", seeds).failures;
+    failures += CheckDomain<double, Closed>("double closed", seeds).failures;
+    failures += CheckDomain<double, HalfOpen>("double half-open", seeds).failures;
+    failures += CheckDomain<double, Open>("double open", seeds).failures;
+    failures += CheckBoxes<2>("2-D", seeds * 4).failures;
+    failures += CheckBoxes<3>("3-D", seeds * 2).failures;
+
+    // Concurrency, threads writers racing with as many readers
+    failures += CheckConcurrentSet<long int, Closed>("concurrent", threads, 20 * seeds).failures;
+    failures += CheckConcurrentSet<long int, Open>("concurrent open", threads, 20 * seeds).failures;
+    failures += CheckConcurrentSet<double, HalfOpen>("concurrent real", threads, 20 * seeds).failures;
+    failures += CheckIngestor<long int, Closed>("ingestor", threads, 20 * seeds).failures;
+    failures += CheckIngestor<double, HalfOpen>("ingestor real", threads, 20 * seeds).failures;
+    failures += CheckShardedSet("sharded", threads, 20 * seeds).failures;
+    failures += CheckSeqlockSet<long int, Closed>("seqlock", threads, 20 * seeds).failures;
+    failures += CheckSeqlockSet<double, HalfOpen>("seqlock real", threads, 20 * seeds).failures;
+
+    // Large collections, for the paths split over threads
+    failures += CheckLargeSetOperations<long int, Closed>("large sets", large).failures;
+    failures += CheckLargeSetOperations<double, Open>("large sets real", large).failures;
+    failures += CheckLargeSort("large sort", large).failures;
+    failures += CheckLargeBoxes<2>("large 2-D", large / 8).failures;
+    failures += CheckLargeBoxes<3>("large 3-D", large / 8).failures;
+    failures += CheckLargeHeatmap<long int, Closed>("large depth", large).failures;
+    failures += CheckLargeHeatmap<long int, Open>("large depth open", large).failures;
+    failures += CheckLargeHeatmap<double, HalfOpen>("large depth real", large).failures;
+    failures += CheckBudgetPeak<long int, Closed>("budget peak", 40000).failures;
+    failures += CheckBudgetPeak<double, HalfOpen>("budget peak real", 40000).failures;
+    std::printf("%zu mismatches\n\n", failures);
+
+    // Performance matrix
+    const std::vector<Backend<Interval>> backends = Backends<long int, Closed>();
+
+    std::printf("%-12s %-11s %10s %14s %12s\n", "backend", "inputs", "build ms", "queries/s", "heap KiB");
+    for (const Distribution &distribution : Distributions()) {
+        Random random(12345);
+        const std::vector<Interval> intervals = distribution.make(random, size);
+        std::vector<Interval> targets = Targets(random, intervals, queries);
+        std::shuffle(targets.begin(), targets.end(), random);
+        targets.erase(targets.begin() + std::min(targets.size(), queries), targets.end());
+
+        for (const Backend<Interval> &backend : backends) {
+            const Measurement measurement = MeasureBackend(backend, intervals, targets);
+            if (measurement.skipped) {
+                std::printf("%-12s %-11s %10s\n", backend.name, distribution.name, "skipped");
+                continue;
+            }
+            std::printf("%-12s %-11s %10.3f %14.0f %12.1f\n", backend.name, distribution.name, measurement.buildSeconds * 1e3,
+                        measurement.queriesPerSecond, static_cast<double>(measurement.heapBytes) / 1024.0);
+        }
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
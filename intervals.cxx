@@ -1,97 +1,4959 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <iterator>
 #include <iostream>
 #include <limits>
+#include <new>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
-// Represents a closed interval [min, max]
+// Describes which of the two ends belong to an interval
+// * Closed [min, max], HalfOpen [min, max) and Open (min, max) are the ones in use, see the aliases below
+//
+// * Everything that depends on the policy is resolved at compile time, so e.g the merge loop for Closed compiles down
+//   to the very same comparison as the original hand-written one - there is no runtime branching on the policy
+template <bool IncludesMin, bool IncludesMax>
+struct BoundaryPolicy {
+    static constexpr bool includesMin = IncludesMin;
+    static constexpr bool includesMax = IncludesMax;
+
+    // True if the interval holds no elements (assumes min <= max, which Interval guarantees)
+    // * For integral domains that's "no integer in it", for floating point ones the interval is treated as a set of
+    //   reals, so only a degenerate interval missing one of its ends is empty
+    template <typename T>
+    static constexpr bool IsEmpty(T min, T max) {
+        if constexpr (includesMin && includesMax) {
+            return false;
+        }
+        else if constexpr (includesMin || includesMax || std::is_floating_point_v<T>) {
+            return min == max;
+        }
+        else {
+            // Note: min + 1 can't overflow here, as min < max
+            return min == max || min + 1 == max;
+        }
+    }
+
+    // True if an interval ending at lastMax and the following one (in the sorted order) starting at nextMin
+    // have no gap between them, e.g can be merged into a single interval
+    // * Closed:   [-1, 1] and [2, 5] do overlap, hence the +1 (written as nextMin - 1 so it can't overflow at the max)
+    // * HalfOpen: [-1, 2) and [2, 5) do overlap, but [-1, 1) and [2, 5) don't
+    // * Open:     (-1, 2) and (1, 5) do overlap, but (-1, 2) and (2, 5) don't, as 2 is in neither of them
+    //
+    // * Floating point domains have no "next value", so there is no +1 - intervals merge when they overlap or touch
+    //   exactly, with the touching point belonging to at least one of them (e.g [0.0, 0.5] and [0.5, 1.0])
+    template <typename T>
+    static constexpr bool Touches(T lastMax, T nextMin) {
+        if constexpr (includesMin && includesMax && !std::is_floating_point_v<T>) {
+            return nextMin <= lastMax || nextMin - 1 == lastMax;
+        }
+        else if constexpr (includesMin || includesMax) {
+            return nextMin <= lastMax;
+        }
+        else {
+            return nextMin < lastMax;
+        }
+    }
+
+    template <typename T>
+    static constexpr bool Contains(T min, T max, T point) {
+        const bool aboveMin = includesMin ? (min <= point) : (min < point);
+        const bool belowMax = includesMax ? (point <= max) : (point < max);
+        return aboveMin && belowMax;
+    }
+
+    // The smallest & the largest integer in a (non-empty) integral interval - e.g its closed equivalent
+    template <typename T>
+    static constexpr T FirstElement(T min) {
+        static_assert(std::is_integral_v<T>, "Only integral intervals have a first element");
+        return includesMin ? min : min + 1;
+    }
+
+    template <typename T>
+    static constexpr T LastElement(T max) {
+        static_assert(std::is_integral_v<T>, "Only integral intervals have a last element");
+        return includesMax ? max : max - 1;
+    }
+};
+
+using Closed = BoundaryPolicy<true, true>;
+using HalfOpen = BoundaryPolicy<true, false>;
+using Open = BoundaryPolicy<false, false>;
+
+
+// Throws Exception, or where exceptions are disabled (e.g -fno-exceptions) prints the message & aborts
+// * Every error of the throwing API goes through it, so the whole library compiles either way
+template <typename Exception>
+[[noreturn]] void ThrowOrAbort(const std::string &message) {
+#if defined(__cpp_exceptions)
+    throw Exception(message);
+#else
+    std::fprintf(stderr, "%s\n", message.c_str());
+    std::abort();
+#endif
+}
+
+// Errors reported by the exception-free API (the Try* & Make members, TryMergeIntervals, TryIsIntervalInUnionOfOthers)
+enum class IntervalErrc {
+    Ok = 0,
+    NotANumber,
+    MaxBelowMin,
+    Unsorted,
+    Cancelled,
+    OverBudget,
+    SpillFailed
+};
+
+constexpr const char* IntervalErrorMessage(IntervalErrc error) noexcept {
+    switch (error) {
+    case IntervalErrc::Ok:
+        return "No error";
+    case IntervalErrc::NotANumber:
+        return "Interval ends can't be NaN";
+    case IntervalErrc::MaxBelowMin:
+        return "Attempting to set max that is less than current min";
+    case IntervalErrc::Unsorted:
+        return "Intervals aren't sorted by min";
+    case IntervalErrc::Cancelled:
+        return "Build cancelled";
+    case IntervalErrc::OverBudget:
+        return "Build doesn't fit its memory budget";
+    case IntervalErrc::SpillFailed:
+        return "Can't write or read back the spill file of the build";
+    }
+    return "Unknown interval error";
+}
+
+// Either a value or the IntervalErrc explaining why there is none - a minimal std::expected<V, IntervalErrc>, which
+// needs C++23
+template <typename V>
+class IntervalExpected {
+public:
+    IntervalExpected(V value) noexcept : _value(std::move(value)) {}
+    IntervalExpected(IntervalErrc error) noexcept : _error(error) {}
+
+    bool HasValue() const noexcept { return _value.has_value(); }
+    explicit operator bool() const noexcept { return HasValue(); }
+
+    // Note: unchecked, like std::expected - only valid if HasValue()
+    const V& operator * () const & noexcept { return *_value; }
+    V&& operator * () && noexcept { return std::move(*_value); }
+    const V* operator -> () const noexcept { return &*_value; }
+
+    // IntervalErrc::Ok if there is a value
+    IntervalErrc Error() const noexcept { return _error; }
+
+private:
+    std::optional<V> _value;
+    IntervalErrc _error = IntervalErrc::Ok;
+};
+
+
+// Represents an interval between min and max, the Boundary policy decides whether the ends belong to it
+// * T is the domain - any integral type, or a floating point one for continuous ranges
 // * Enforces min < max
 //
 // * Note: No it doesn't - the constructor, as it's implemented enforces min <= max. Will leave it as it is to support degenerate intervals
-class Interval {
+// * Note: For policies other than Closed a degenerate interval may hold no elements at all (e.g [1, 1)), see IsEmpty()
+template <typename T, typename Boundary = Closed>
+class BasicInterval {
+    static_assert(std::is_arithmetic_v<T>, "Interval domain has to be an integral or floating point type");
+
 public:
-    typedef long int Integer;
+    typedef T Value;
+    typedef Boundary BoundaryType;
+
+    BasicInterval(Value min, Value max) : _min(min), _max(max) {
+        if (const IntervalErrc error = Validate(min, max); error != IntervalErrc::Ok) [[unlikely]] {
+            ThrowOrAbort<std::invalid_argument>(IntervalErrorMessage(error));
+        }
 
-    Interval(Integer min, Integer max) : _min(min), _max(max) {
         if (_max < _min) {
             std::swap(_min, _max);
         }
     }
 
-    Integer Min() const { return _min; }
-    Integer Max() const { return _max; }
+    // The constructor without exceptions, for code built with -fno-exceptions
+    static IntervalExpected<BasicInterval> Make(Value min, Value max) noexcept {
+        if (const IntervalErrc error = Validate(min, max); error != IntervalErrc::Ok) [[unlikely]] {
+            return error;
+        }
+        return (max < min) ? FromOrdered(max, min) : FromOrdered(min, max);
+    }
+
+    // Skips every check - min <= max & neither of them being NaN are up to the caller (e.g the merge loop, where the
+    // ends come from Intervals already)
+    static BasicInterval FromOrdered(Value min, Value max) noexcept {
+        return BasicInterval(min, max, Ordered());
+    }
+
+    Value Min() const noexcept { return _min; }
+    Value Max() const noexcept { return _max; }
+
+    bool IsEmpty() const noexcept { return Boundary::IsEmpty(_min, _max); }
 
     // Added a setter as the alternative to modyfying an Interval would be inserting & removing elements during merging
     // * I find this aproach both cleaner and faster (than shifting elements in vector)
-    void SetMax(Integer max) {
+    void SetMax(Value max) {
+        if (const IntervalErrc error = TrySetMax(max); error != IntervalErrc::Ok) [[unlikely]] {
+            ThrowOrAbort<std::invalid_argument>(IntervalErrorMessage(error));
+        }
+    }
+
+    // SetMax without exceptions, the Interval is left unchanged on error
+    IntervalErrc TrySetMax(Value max) noexcept {
         // Note: assuming that degenerate intervals (e.g [1, 1]) are permitted, hence >=
+        // * NaN compares false against everything, so it fails here too
         if (max >= _min) [[likely]] {
             _max = max;
+            return IntervalErrc::Ok;
         }
-        else {
-            throw std::invalid_argument("Attempting to set max that is less than current min");
+
+        if constexpr (std::is_floating_point_v<Value>) {
+            if (std::isnan(max)) {
+                return IntervalErrc::NotANumber;
+            }
         }
+        return IntervalErrc::MaxBelowMin;
     }
 
     // Overloading < operator will allow the use of std::sort on Interval
-    bool operator < (const Interval  &other) const {
+    bool operator < (const BasicInterval &other) const noexcept {
         return (_min < other.Min());
     }
 
 private:
-    Integer _min;
-    Integer _max;
+    struct Ordered {};
+
+    BasicInterval(Value min, Value max, Ordered) noexcept : _min(min), _max(max) {}
+
+    static IntervalErrc Validate([[maybe_unused]] Value min, [[maybe_unused]] Value max) noexcept {
+        if constexpr (std::is_floating_point_v<Value>) {
+            // NaN isn't ordered against anything, so it can't be an end of an interval
+            if (std::isnan(min) || std::isnan(max)) [[unlikely]] {
+                return IntervalErrc::NotANumber;
+            }
+        }
+        return IntervalErrc::Ok;
+    }
+
+    Value _min;
+    Value _max;
 };
 
+// The closed integer interval [min, max] - the original Interval
+using Interval = BasicInterval<long int, Closed>;
+
+// The closed real interval [min, max]
+using RealInterval = BasicInterval<double, Closed>;
+
 // Overloading == operator will allow for easy (in terms of syntax, at least) comparing vector<Interval>
-bool operator == (const Interval& lhs, const Interval& rhs) {
+template <typename T, typename Boundary>
+bool operator == (const BasicInterval<T, Boundary>& lhs, const BasicInterval<T, Boundary>& rhs) {
     return (lhs.Min() == rhs.Min() && lhs.Max() == rhs.Max());
 }
 
 // Merges overlapping Intervals and returns them in a vector
-std::vector<Interval> MergeIntervals(std::vector<Interval> &intervals) {
-    // Construct output vector from 1st element of intervals
-    std::vector<Interval> output (1, intervals.front());
+// * Expects intervals to be sorted by min
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> MergeIntervals(std::vector<BasicInterval<T, Boundary>> &intervals) {
+    std::vector<BasicInterval<T, Boundary>> output;
+    output.reserve(intervals.size());
+
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        // Empty intervals hold no elements, so they are skipped rather than ending up as stray pieces of the output
+        // * For Closed this is always false and the check compiles away
+        if (intervals[i].IsEmpty()) {
+            continue;
+        }
+
+        if (output.empty()) [[unlikely]] {
+            output.push_back(intervals[i]);
+            continue;
+        }
 
-    for (size_t i = 1; i < intervals.size(); ++i) {
-        Interval& lastInterval = output.back();
+        BasicInterval<T, Boundary>& lastInterval = output.back();
 
-        // Check if Intervals are overlaping: e.g the min of a given Interval is <= max of the preceeding Interval +1
-        // * The +1 is there to account for Intervals being a closed integral intervals
+        // Check if Intervals are overlaping: the rule depends on the boundary policy, see BoundaryPolicy::Touches
+        // * e.g for closed integral intervals the min of a given Interval has to be <= max of the preceeding Interval +1
         // * so [-1, 1] and [2, 5] do overlap
-        if (lastInterval.Max() + 1 < intervals[i].Min()) {
+        if (!Boundary::Touches(lastInterval.Max(), intervals[i].Min())) {
             output.push_back(intervals[i]);
         }
         else if (lastInterval.Max() < intervals[i].Max()) {
-            lastInterval.SetMax(intervals[i].Max());
+            // Can't fail, the new max is above the old one - so the checks of SetMax are skipped
+            lastInterval = BasicInterval<T, Boundary>::FromOrdered(lastInterval.Min(), intervals[i].Max());
         }
     }
 
     return output;
 }
 
-// Returns true if every element of Interval under test is contained in the union of Intervals in the vector
-bool IsIntervalInUnionOfOthers(const Interval &interval, const std::vector<Interval> &intervals) {
-    if (intervals.empty()) {
+// MergeIntervals without exceptions or allocations: the Intervals are merged in place, leaving only the merged ones
+// * Returns IntervalErrc::Unsorted if they turn out not to be sorted by min (which MergeIntervals just assumes), the
+//   Intervals are valid but in an unspecified order then
+template <typename T, typename Boundary>
+IntervalErrc TryMergeIntervals(std::vector<BasicInterval<T, Boundary>> &intervals) noexcept {
+    // The merged Intervals are intervals[0, merged), never past the one being read
+    size_t merged = 0;
+    T previousMin = T();
+
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        const BasicInterval<T, Boundary> next = intervals[i];
+        if (i > 0 && next.Min() < previousMin) [[unlikely]] {
+            return IntervalErrc::Unsorted;
+        }
+        previousMin = next.Min();
+
+        if (next.IsEmpty()) {
+            continue;
+        }
+
+        if (merged == 0 || !Boundary::Touches(intervals[merged - 1].Max(), next.Min())) {
+            intervals[merged++] = next;
+        }
+        else if (intervals[merged - 1].Max() < next.Max()) {
+            intervals[merged - 1] = BasicInterval<T, Boundary>::FromOrdered(intervals[merged - 1].Min(), next.Max());
+        }
+    }
+
+    // Note: erasing trivially copyable elements from the end doesn't throw
+    intervals.erase(intervals.begin() + static_cast<std::ptrdiff_t>(merged), intervals.end());
+    return IntervalErrc::Ok;
+}
+
+// Inserts the Interval into already sorted & merged Intervals, coalescing it with the ones it overlaps or touches
+// * O(log n) to find them plus the shift of the elements after them
+template <typename T, typename Boundary>
+void InsertIntoMergedIntervals(std::vector<BasicInterval<T, Boundary>> &merged, const BasicInterval<T, Boundary> &interval) {
+    if (interval.IsEmpty()) {
+        return;
+    }
+
+    // Intervals ending (with a gap) before the new one, then the ones it overlaps or touches, then the ones past it
+    const auto first = std::partition_point(merged.begin(), merged.end(), [&interval](const BasicInterval<T, Boundary> &other) {
+        return !Boundary::Touches(other.Max(), interval.Min());
+    });
+    const auto last = std::partition_point(first, merged.end(), [&interval](const BasicInterval<T, Boundary> &other) {
+        return Boundary::Touches(interval.Max(), other.Min());
+    });
+
+    if (first == last) {
+        merged.insert(first, interval);
+        return;
+    }
+
+    const T min = std::min(interval.Min(), first->Min());
+    const T max = std::max(interval.Max(), std::prev(last)->Max());
+
+    *first = BasicInterval<T, Boundary>(min, max);
+    merged.erase(std::next(first), last);
+}
+
+// FNV-1a over the bounds of the Intervals, identifies a collection in query traces & slow query logs
+// * Cheap enough to compute at build time, collisions don't matter beyond mixing up two collections of one trace
+template <typename T, typename Boundary>
+std::uint64_t FingerprintIntervals(const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    std::uint64_t hash = 14695981039346656037ull;
+
+    for (const BasicInterval<T, Boundary> &interval : intervals) {
+        const T bounds[2] = {interval.Min(), interval.Max()};
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(bounds);
+        for (size_t i = 0; i < sizeof(bounds); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    // Note: 0 marks an untraced index, so it's never a fingerprint
+    return (hash == 0) ? 1 : hash;
+}
+
+// Log of coverage queries & index builds slower than a threshold, for catching pathological inputs in production
+// * Install one & IsIntervalInUnionOfOthers & BasicCoverageIndex (builds & queries) time their calls, any call over
+//   the threshold gets its target interval, the size & fingerprint of the collection (optionally the whole collection)
+//   & the time of each of its phases appended to the log as a line of text
+// * Not installed it costs a single, well predicted, branch per call, no clock is read
+// * The log rotates: once it would grow past maxBytes it's renamed to path.1 (path.1 to path.2 & so on, up to
+//   path.maxFiles) & a new one started
+class SlowQueryLog {
+public:
+    struct Options {
+        std::string path;
+        std::chrono::nanoseconds threshold = std::chrono::milliseconds(10);
+        size_t maxBytes = 16 << 20;
+        unsigned maxFiles = 4;
+        bool captureCollection = false;
+    };
+
+    // Splits a call into phases & tells if it was slow, does nothing at all when constructed with no log
+    class Timer {
+    public:
+        explicit Timer(SlowQueryLog *log) : _log(log) {
+            if (_log) [[unlikely]] {
+                _start = _last = std::chrono::steady_clock::now();
+            }
+        }
+
+        // Ends the current phase (started at the previous Mark, or construction) & names it
+        void Mark(const char *phase) {
+            if (_log && _phases < maxPhases) [[unlikely]] {
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                _names[_phases] = phase;
+                _times[_phases++] = now - _last;
+                _last = now;
+            }
+        }
+
+        // The log to write to if the call was over the threshold, nullptr otherwise
+        SlowQueryLog* Slow() const {
+            return (_log && _last - _start >= _log->_options.threshold) ? _log : nullptr;
+        }
+
+    private:
+        friend class SlowQueryLog;
+
+        static constexpr size_t maxPhases = 4;
+
+        SlowQueryLog *_log;
+        std::chrono::steady_clock::time_point _start, _last;
+        size_t _phases = 0;
+        const char *_names[maxPhases] = {};
+        std::chrono::nanoseconds _times[maxPhases] = {};
+    };
+
+    explicit SlowQueryLog(Options options) : _options(std::move(options)) {
+        if (_options.path.empty()) {
+            ThrowOrAbort<std::invalid_argument>("Slow query log needs a path");
+        }
+        Open();
+    }
+
+    ~SlowQueryLog() {
+        SlowQueryLog *self = this;
+        _active.compare_exchange_strong(self, nullptr);
+    }
+
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator = (const SlowQueryLog&) = delete;
+
+    // Starts (or with nullptr stops) logging, the log has to outlive its installation
+    static void Install(SlowQueryLog *log) {
+        _active.store(log, std::memory_order_release);
+    }
+
+    static SlowQueryLog* Active() {
+        return _active.load(std::memory_order_acquire);
+    }
+
+    // Appends the entry of a slow call, target is nullptr for builds
+    template <typename T, typename Boundary>
+    void Write(const char *operation, const Timer &timer, const BasicInterval<T, Boundary> *target,
+               const std::vector<BasicInterval<T, Boundary>> &collection) {
+        std::ostringstream entry;
+        entry.precision(std::numeric_limits<T>::max_digits10);
+
+        entry << "slow " << operation << " ns=" << std::chrono::nanoseconds(timer._last - timer._start).count();
+        if (target) {
+            entry << " target=";
+            Format(entry, *target);
+        }
+        entry << " size=" << collection.size() << " hash=" << std::hex << FingerprintIntervals(collection) << std::dec;
+
+        for (size_t i = 0; i < timer._phases; ++i) {
+            entry << ' ' << timer._names[i] << "_ns=" << timer._times[i].count();
+        }
+
+        if (_options.captureCollection) {
+            entry << " collection=";
+            for (const BasicInterval<T, Boundary> &interval : collection) {
+                Format(entry, interval);
+            }
+        }
+        entry << '\n';
+
+        const std::string line = entry.str();
+
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_written > 0 && _written + line.size() > _options.maxBytes) {
+            Rotate();
+        }
+        _file << line;
+        _file.flush();
+        _written += line.size();
+    }
+
+private:
+    template <typename T, typename Boundary>
+    static void Format(std::ostringstream &entry, const BasicInterval<T, Boundary> &interval) {
+        entry << (Boundary::includesMin ? '[' : '(') << interval.Min() << ',' << interval.Max()
+              << (Boundary::includesMax ? ']' : ')');
+    }
+
+    void Open() {
+        _file.open(_options.path, std::ios::app);
+        if (!_file) {
+            ThrowOrAbort<std::runtime_error>("Can't open slow query log " + _options.path);
+        }
+        _file.seekp(0, std::ios::end);
+        _written = static_cast<size_t>(_file.tellp());
+    }
+
+    void Rotate() {
+        _file.close();
+
+        // Note: the oldest file (if any) gets overwritten by the rename on POSIX, removing it first covers the rest
+        const std::string oldest = _options.path + "." + std::to_string(std::max(_options.maxFiles, 1u));
+        std::remove(oldest.c_str());
+        for (unsigned i = std::max(_options.maxFiles, 1u) - 1; i > 0; --i) {
+            const std::string from = _options.path + "." + std::to_string(i);
+            const std::string to = _options.path + "." + std::to_string(i + 1);
+            std::rename(from.c_str(), to.c_str());
+        }
+        std::rename(_options.path.c_str(), (_options.path + ".1").c_str());
+
+        Open();
+    }
+
+    static inline std::atomic<SlowQueryLog*> _active{nullptr};
+
+    Options _options;
+    std::mutex _lock;
+    std::ofstream _file;
+    size_t _written = 0;
+};
+
+// Crossover points between the algorithms the library picks from, depending on the size of the input
+// * The defaults suit a typical x86-64 server, autotune.cxx measures them on the host & writes them to a config file
+// * sortingNetworkMax: SortIntervals sorts up to this many Intervals with a sorting network
+// * radixSortMin: SortIntervals radix sorts integral Intervals from this many on (std::sort in between)
+// * clipScanMin: IsIntervalInUnionOfOthers clips the collection to the target first from this many Intervals on
+// * indexedQueriesMin: AreIntervalsInUnionOfOthers builds a BasicCoverageIndex from this many targets on
+struct DispatchThresholds {
+    size_t sortingNetworkMax = 16;
+    size_t radixSortMin = 16384;
+    size_t clipScanMin = 64;
+    size_t indexedQueriesMin = 8;
+};
+
+// Reads thresholds from a config of "name = value" lines ('#' starts a comment), names missing from it keep their defaults
+// * Returns false with the reason in error for unknown names, malformed values & files that can't be read
+inline bool ReadDispatchThresholds(const std::string &path, DispatchThresholds &thresholds, std::string &error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "Can't open dispatch thresholds " + path;
         return false;
     }
 
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        std::string name, equals;
+        size_t value;
+        if (!(fields >> name)) {
+            continue;
+        }
+        if (!(fields >> equals >> value) || equals != "=") {
+            error = "Malformed dispatch threshold: " + line;
+            return false;
+        }
+
+        if (name == "sortingNetworkMax") {
+            thresholds.sortingNetworkMax = value;
+        }
+        else if (name == "radixSortMin") {
+            thresholds.radixSortMin = value;
+        }
+        else if (name == "clipScanMin") {
+            thresholds.clipScanMin = value;
+        }
+        else if (name == "indexedQueriesMin") {
+            thresholds.indexedQueriesMin = value;
+        }
+        else {
+            error = "Unknown dispatch threshold: " + name;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ReadDispatchThresholds, throwing std::invalid_argument for unknown names & malformed values, std::runtime_error if
+// the file can't be read
+inline DispatchThresholds LoadDispatchThresholds(const std::string &path) {
+    DispatchThresholds thresholds;
+    std::string error;
+    if (!ReadDispatchThresholds(path, thresholds, error)) {
+        if (std::ifstream(path)) {
+            ThrowOrAbort<std::invalid_argument>(error);
+        }
+        ThrowOrAbort<std::runtime_error>(error);
+    }
+    return thresholds;
+}
+
+// The thresholds in use - loaded on first use from the file named by the INTERVALS_TUNING environment variable if set
+// (and readable), the defaults otherwise
+// * Note: not synchronised, so SetDispatchThresholds belongs to start up, before the library is used from other threads
+inline DispatchThresholds& ActiveDispatchThresholds() {
+    static DispatchThresholds thresholds = []() {
+        const char *path = std::getenv("INTERVALS_TUNING");
+        // A bad config mustn't take the process down at start up, the defaults are always correct - just slower
+        DispatchThresholds loaded;
+        std::string error;
+        if (path && *path && ReadDispatchThresholds(path, loaded, error)) {
+            return loaded;
+        }
+        return DispatchThresholds();
+    }();
+
+    return thresholds;
+}
+
+inline void SetDispatchThresholds(const DispatchThresholds &thresholds) {
+    ActiveDispatchThresholds() = thresholds;
+}
+
+// Comparators of Batcher's odd-even merge sort network for count elements, in the order they have to be applied
+// * Works for any count, not just powers of 2 - the comparators reaching past the end are left out
+inline std::vector<std::pair<std::uint8_t, std::uint8_t>> SortingNetwork(size_t count) {
+    std::vector<std::pair<std::uint8_t, std::uint8_t>> comparators;
+
+    for (size_t p = 1; p < count; p <<= 1) {
+        for (size_t k = p; k >= 1; k >>= 1) {
+            for (size_t j = k % p; j + k < count; j += 2 * k) {
+                for (size_t i = 0; i < std::min(k, count - j - k); ++i) {
+                    // Only pairs within the same block of 2p get compared
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        comparators.emplace_back(std::uint8_t(i + j), std::uint8_t(i + j + k));
+                    }
+                }
+            }
+        }
+    }
+
+    return comparators;
+}
+
+// Largest number of Intervals NetworkSortIntervals sorts with a network, it falls back to std::sort past it
+constexpr size_t maxSortingNetwork = 64;
+
+// Sorts the Intervals by min with a sorting network - a fixed, data independent sequence of compare-exchanges, done
+// without branches (with AVX2, see below) so there are none of std::sort's mispredictions for a handful of Intervals
+// * The networks are generated once, on first use
+template <typename T, typename Boundary>
+void NetworkSortIntervals(std::vector<BasicInterval<T, Boundary>> &intervals) {
+    if (intervals.size() > maxSortingNetwork) {
+        std::sort(intervals.begin(), intervals.end());
+        return;
+    }
+
+    static const std::vector<std::vector<std::pair<std::uint8_t, std::uint8_t>>> networks = []() {
+        std::vector<std::vector<std::pair<std::uint8_t, std::uint8_t>>> all;
+        for (size_t count = 0; count <= maxSortingNetwork; ++count) {
+            all.push_back(SortingNetwork(count));
+        }
+        return all;
+    }();
+
+    const std::vector<std::pair<std::uint8_t, std::uint8_t>> &network = networks[intervals.size()];
+
+#if defined(__AVX2__)
+    // An Interval of a 64-bit domain fits an SSE register, so each compare-exchange is a compare & two blends, with no
+    // branch & no store forwarding stalls from splitting an Interval into its bounds
+    if constexpr (sizeof(T) == 8 && (std::is_floating_point_v<T> || std::is_signed_v<T>)) {
+        static_assert(sizeof(BasicInterval<T, Boundary>) == 2 * sizeof(T), "Interval has to be laid out as a plain {min, max} pair");
+        __m128i *data = reinterpret_cast<__m128i *>(intervals.data());
+
+        for (const auto &[lowIndex, highIndex] : network) {
+            const __m128i low = _mm_loadu_si128(data + lowIndex);
+            const __m128i high = _mm_loadu_si128(data + highIndex);
+
+            // Compares the mins & copies the result to the max lane as well
+            __m128i swap;
+            if constexpr (std::is_floating_point_v<T>) {
+                swap = _mm_castpd_si128(_mm_movedup_pd(_mm_cmplt_pd(_mm_castsi128_pd(high), _mm_castsi128_pd(low))));
+            }
+            else {
+                swap = _mm_shuffle_epi32(_mm_cmpgt_epi64(low, high), 0x44);
+            }
+
+            _mm_storeu_si128(data + lowIndex, _mm_blendv_epi8(low, high, swap));
+            _mm_storeu_si128(data + highIndex, _mm_blendv_epi8(high, low, swap));
+        }
+        return;
+    }
+#endif
+
+    for (const auto &[lowIndex, highIndex] : network) {
+        BasicInterval<T, Boundary> &low = intervals[lowIndex];
+        BasicInterval<T, Boundary> &high = intervals[highIndex];
+        if (high < low) {
+            std::swap(low, high);
+        }
+    }
+}
+
+// Sorts integral Intervals by min with an LSD radix sort, a byte per pass - O(n) per pass
+// * All the byte histograms are counted in one pass up front, passes where every min has the same byte are skipped
+template <typename T, typename Boundary>
+void RadixSortIntervals(std::vector<BasicInterval<T, Boundary>> &intervals) {
+    static_assert(std::is_integral_v<T>, "Radix sort needs an integral domain");
+    typedef std::make_unsigned_t<T> Unsigned;
+
+    // Flipping the sign bit orders signed mins the same as their unsigned keys
+    const auto key = [](const BasicInterval<T, Boundary> &interval) {
+        Unsigned value = static_cast<Unsigned>(interval.Min());
+        if constexpr (std::is_signed_v<T>) {
+            value ^= Unsigned(1) << (8 * sizeof(T) - 1);
+        }
+        return value;
+    };
+
+    const size_t count = intervals.size();
+    std::vector<std::array<size_t, 256>> histograms(sizeof(T));
+    for (const BasicInterval<T, Boundary> &interval : intervals) {
+        const Unsigned value = key(interval);
+        for (size_t pass = 0; pass < sizeof(T); ++pass) {
+            ++histograms[pass][(value >> (8 * pass)) & 0xFF];
+        }
+    }
+
+    std::vector<BasicInterval<T, Boundary>> buffer(count, BasicInterval<T, Boundary>(T{}, T{}));
+
+    for (size_t pass = 0; pass < sizeof(T); ++pass) {
+        std::array<size_t, 256> &histogram = histograms[pass];
+        if (std::find(histogram.begin(), histogram.end(), count) != histogram.end()) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t &bucket : histogram) {
+            offset += std::exchange(bucket, offset);
+        }
+
+        for (const BasicInterval<T, Boundary> &interval : intervals) {
+            buffer[histogram[(key(interval) >> (8 * pass)) & 0xFF]++] = interval;
+        }
+        intervals.swap(buffer);
+    }
+}
+
+// Sorts the Intervals by min, with the algorithm the dispatch thresholds pick for their number
+template <typename T, typename Boundary>
+void SortIntervals(std::vector<BasicInterval<T, Boundary>> &intervals) {
+    const DispatchThresholds &thresholds = ActiveDispatchThresholds();
+
+    if (intervals.size() <= thresholds.sortingNetworkMax) {
+        NetworkSortIntervals(intervals);
+        return;
+    }
+
+    if constexpr (std::is_integral_v<T>) {
+        if (intervals.size() >= thresholds.radixSortMin) {
+            RadixSortIntervals(intervals);
+            return;
+        }
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+}
+
+// IsIntervalInUnionOfOthers the original way: sort & merge the whole collection, then check if merging the Interval
+// under test into it changes anything
+template <typename T, typename Boundary>
+bool IsIntervalInUnionBySorting(const BasicInterval<T, Boundary> &interval, const std::vector<BasicInterval<T, Boundary>> &intervals,
+                                SlowQueryLog::Timer &timer) {
     // Need a local copy due to intervals being const reference
     // * The prefered aproach would be taking a non-const reference, which seems acceptable in this particular exercise
-    std::vector<Interval> intervalsCopy(intervals);
+    std::vector<BasicInterval<T, Boundary>> intervalsCopy(intervals);
+    timer.Mark("copy");
 
     // Sort the list of intervals by the min, in ascending order
     // * as having an ordered elements simplifies merging of Intervals
-    std::sort(intervalsCopy.begin(), intervalsCopy.end());
+    SortIntervals(intervalsCopy);
+    timer.Mark("sort");
 
     intervalsCopy = MergeIntervals(intervalsCopy);
+    timer.Mark("merge");
 
     // Copy-constructing another vector to hold all the Interval collection as well as Interval under test
-    std::vector<Interval> allIntervals(intervalsCopy);
+    std::vector<BasicInterval<T, Boundary>> allIntervals(intervalsCopy);
 
     // Insert the Interval under test at the correct position in the vector to preserve its ordering
     allIntervals.insert(lower_bound(allIntervals.begin(), allIntervals.end(), interval), interval);
 
     // Merge all Intervals, then check if if the resulting vector differs from intervalsCopy
     // * If it does, there must have been elements of Interval under test that were not present in the collection of Intervals
-    return (MergeIntervals(allIntervals) == intervalsCopy);
+    const bool covered = (MergeIntervals(allIntervals) == intervalsCopy);
+    timer.Mark("check");
+
+    return covered;
+}
+
+// IsIntervalInUnionOfOthers by clipping the collection to the Interval under test first, so only the parts of it
+// that matter get sorted & merged - usually a small fraction of a large collection
+// * Clipping is an exact intersection for every boundary policy, so the union of the clipped Intervals is the union of
+//   the collection within the Interval under test, which is covered if that merges into a single piece spanning it
+template <typename T, typename Boundary>
+bool IsIntervalInUnionByClipping(const BasicInterval<T, Boundary> &interval, const std::vector<BasicInterval<T, Boundary>> &intervals,
+                                 SlowQueryLog::Timer &timer) {
+    std::vector<BasicInterval<T, Boundary>> clipped;
+
+    for (const BasicInterval<T, Boundary> &other : intervals) {
+        const T min = std::max(other.Min(), interval.Min());
+        const T max = std::min(other.Max(), interval.Max());
+
+        // Note: checked before constructing, as the constructor would swap reversed ends rather than reject them
+        if (min <= max && !Boundary::IsEmpty(min, max)) {
+            clipped.emplace_back(min, max);
+        }
+    }
+    timer.Mark("clip");
+
+    SortIntervals(clipped);
+    timer.Mark("sort");
+
+    const std::vector<BasicInterval<T, Boundary>> merged = MergeIntervals(clipped);
+    timer.Mark("merge");
+
+    return (!merged.empty() && merged.front().Min() <= interval.Min() && interval.Max() <= merged.front().Max());
+}
+
+template <typename T, typename Boundary = Closed>
+class BasicQueryTraceRecorder;
+
+// Returns true if every element of Interval under test is contained in the union of Intervals in the vector
+// * The interval under test and the collection share the boundary policy, so e.g half-open time ranges can be
+//   passed as they are, without converting them to closed intervals first
+// * Small collections are sorted & merged whole, larger ones clipped to the Interval under test first (see
+//   DispatchThresholds::clipScanMin)
+// * Calls are recorded into an installed BasicQueryTraceRecorder, the collection once per distinct one
+template <typename T, typename Boundary>
+bool IsIntervalInUnionOfOthers(const BasicInterval<T, Boundary> &interval, const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    // An empty interval is a subset of anything
+    if (interval.IsEmpty()) {
+        return true;
+    }
+
+    if (intervals.empty()) {
+        return false;
+    }
+
+    SlowQueryLog::Timer timer(SlowQueryLog::Active());
+
+    const bool covered = (intervals.size() >= ActiveDispatchThresholds().clipScanMin)
+                       ? IsIntervalInUnionByClipping(interval, intervals, timer)
+                       : IsIntervalInUnionBySorting(interval, intervals, timer);
+
+    if (SlowQueryLog *log = timer.Slow()) [[unlikely]] {
+        log->Write("IsIntervalInUnionOfOthers", timer, &interval, intervals);
+    }
+
+    if (BasicQueryTraceRecorder<T, Boundary> *recorder = BasicQueryTraceRecorder<T, Boundary>::Active()) [[unlikely]] {
+        recorder->RecordUnionContains(recorder->RecordCollection(intervals), interval, covered);
+    }
+
+    return covered;
+}
+
+// IsIntervalInUnionOfOthers without exceptions or allocations, for code built with -fno-exceptions
+// * The collection is clipped to the Interval under test into scratch, which the caller provides with room for count
+//   Intervals, then sorted there & swept - so the collection itself is left as it is
+// * Takes the ends rather than an Interval, so invalid ones (NaN) are reported rather than thrown
+// * Neither logged to the slow query log nor traced, as both do I/O that can fail
+template <typename T, typename Boundary>
+IntervalExpected<bool> TryIsIntervalInUnionOfOthers(T min, T max, const BasicInterval<T, Boundary> *intervals, size_t count,
+                                                    BasicInterval<T, Boundary> *scratch) noexcept {
+    const IntervalExpected<BasicInterval<T, Boundary>> interval = BasicInterval<T, Boundary>::Make(min, max);
+    if (!interval) [[unlikely]] {
+        return interval.Error();
+    }
+    if (interval->IsEmpty()) {
+        return true;
+    }
+
+    size_t clipped = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const T clippedMin = std::max(intervals[i].Min(), interval->Min());
+        const T clippedMax = std::min(intervals[i].Max(), interval->Max());
+        if (clippedMin <= clippedMax && !Boundary::IsEmpty(clippedMin, clippedMax)) {
+            scratch[clipped++] = BasicInterval<T, Boundary>::FromOrdered(clippedMin, clippedMax);
+        }
+    }
+
+    std::sort(scratch, scratch + clipped);
+
+    // The clipped Intervals lie within the Interval under test, so they cover it if they chain from its min to its max
+    if (clipped == 0 || interval->Min() < scratch[0].Min()) {
+        return false;
+    }
+
+    T reach = scratch[0].Max();
+    for (size_t i = 1; i < clipped && reach < interval->Max(); ++i) {
+        if (!Boundary::Touches(reach, scratch[i].Min())) {
+            return false;
+        }
+        reach = std::max(reach, scratch[i].Max());
+    }
+    return !(reach < interval->Max());
+}
+
+// Coverage depth & covered fraction over a range of the domain, split into equal buckets
+// * depth[i] is the average number of Intervals over the points of bucket i, coverage[i] the fraction of it in their union
+// * Integral Intervals are measured by their elements (x spans [x, x + 1)), floating point ones by their length
+struct CoverageHeatmap {
+    double min = 0.0;
+    double max = 0.0;
+    std::vector<double> depth;
+    std::vector<double> coverage;
+};
+
+// Adds the share of every bucket that each of the Intervals spans to depth - O(n + buckets) with a difference array
+// * Buckets fully inside an Interval get +1 through the difference array, the (at most two) partial ones at its ends
+//   get their fraction directly
+template <typename T, typename Boundary>
+void AccumulateHeatmapBuckets(const BasicInterval<T, Boundary> *first, const BasicInterval<T, Boundary> *last,
+                              double min, double max, std::vector<double> &depth) {
+    const size_t buckets = depth.size();
+    const double scale = static_cast<double>(buckets) / (max - min);
+
+    std::vector<double> difference(buckets + 1, 0.0);
+
+    for (; first != last; ++first) {
+        if (first->IsEmpty()) {
+            continue;
+        }
+
+        double from, to;
+        if constexpr (std::is_integral_v<T>) {
+            from = static_cast<double>(Boundary::FirstElement(first->Min()));
+            to = static_cast<double>(Boundary::LastElement(first->Max())) + 1.0;
+        }
+        else {
+            from = static_cast<double>(first->Min());
+            to = static_cast<double>(first->Max());
+        }
+
+        from = (std::max(from, min) - min) * scale;
+        to = (std::min(to, max) - min) * scale;
+        if (!(from < to)) {
+            continue;
+        }
+
+        const size_t fromBucket = std::min(static_cast<size_t>(from), buckets - 1);
+        const size_t toBucket = std::min(static_cast<size_t>(to), buckets - 1);
+
+        if (fromBucket == toBucket) {
+            depth[fromBucket] += to - from;
+        }
+        else {
+            depth[fromBucket] += static_cast<double>(fromBucket + 1) - from;
+            difference[fromBucket + 1] += 1.0;
+            difference[toBucket] -= 1.0;
+            depth[toBucket] += to - static_cast<double>(toBucket);
+        }
+    }
+
+    double running = 0.0;
+    for (size_t i = 0; i < buckets; ++i) {
+        running += difference[i];
+        depth[i] += running;
+    }
+}
+
+// Splits the Intervals between threads, each accumulating into its own buckets, which are summed up at the end
+// * Every chunk adds its own copy of the buckets, so there are no more chunks than fit in the Intervals (chunks *
+//   buckets <= n) - keeping it O(n + buckets) overall
+template <typename T, typename Boundary>
+std::vector<double> ComputeHeatmapBuckets(const std::vector<BasicInterval<T, Boundary>> &intervals, double min, double max,
+                                          size_t buckets, unsigned threads) {
+    // Note: not worth a thread below ~64K Intervals
+    const size_t chunks = std::clamp<size_t>(std::min(intervals.size() / 65536, intervals.size() / buckets), 1,
+                                             std::max(threads, 1u));
+    const size_t chunkSize = (intervals.size() + chunks - 1) / chunks;
+
+    std::vector<std::vector<double>> partial(chunks, std::vector<double>(buckets, 0.0));
+    std::vector<std::future<void>> running;
+
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        const size_t from = std::min(chunk * chunkSize, intervals.size());
+        const size_t to = std::min(from + chunkSize, intervals.size());
+
+        running.push_back(std::async(chunk == 0 ? std::launch::deferred : std::launch::async, [&, from, to, chunk]() {
+            AccumulateHeatmapBuckets(intervals.data() + from, intervals.data() + to, min, max, partial[chunk]);
+        }));
+    }
+
+    for (std::future<void> &result : running) {
+        result.get();
+    }
+
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        for (size_t i = 0; i < buckets; ++i) {
+            partial[0][i] += partial[chunk][i];
+        }
+    }
+
+    return std::move(partial[0]);
+}
+
+// Builds the heatmap of range, depth from the raw Intervals and coverage from the very same Intervals merged
+// * Both are a single pass over the Intervals plus one over the buckets, rather than a coverage query per bucket
+template <typename T, typename Boundary>
+CoverageHeatmap BuildCoverageHeatmap(const std::vector<BasicInterval<T, Boundary>> &intervals,
+                                     const std::vector<BasicInterval<T, Boundary>> &merged,
+                                     const BasicInterval<T, Boundary> &range, size_t buckets,
+                                     unsigned threads = std::thread::hardware_concurrency()) {
+    if (buckets == 0 || range.IsEmpty()) {
+        ThrowOrAbort<std::invalid_argument>("Heatmap needs a non-empty range and at least one bucket");
+    }
+
+    CoverageHeatmap heatmap;
+    if constexpr (std::is_integral_v<T>) {
+        heatmap.min = static_cast<double>(Boundary::FirstElement(range.Min()));
+        heatmap.max = static_cast<double>(Boundary::LastElement(range.Max())) + 1.0;
+    }
+    else {
+        heatmap.min = static_cast<double>(range.Min());
+        heatmap.max = static_cast<double>(range.Max());
+    }
+
+    heatmap.depth = ComputeHeatmapBuckets(intervals, heatmap.min, heatmap.max, buckets, threads);
+    heatmap.coverage = ComputeHeatmapBuckets(merged, heatmap.min, heatmap.max, buckets, threads);
+
+    return heatmap;
+}
+
+// Kinds of the records of a query trace
+enum class TraceRecord : std::uint8_t {
+    Build = 1,
+    Contains = 2,
+    ContainsPoint = 3,
+    ContainsPoints = 4,
+    UnionContains = 5
+};
+
+// Opt-in recorder of coverage index builds & queries into a compact binary trace, replayed by benchmark.cxx
+// * Install one & every BasicCoverageIndex of the same domain & boundary policy built while it is installed logs its
+//   inputs (with the fingerprint of its merged Intervals) & then every query made on it, with the answer given
+// * IsIntervalInUnionOfOthers logs its calls too - the collection as a build the first time it's seen (by the
+//   fingerprint of its Intervals as given), then each call as a UnionContains query on it
+// * Indexes built before the recorder was installed stay untraced - the fingerprint is only computed when recording
+// * Not installed it costs the queries a single, well predicted, branch on a member of the index (on the installed
+//   recorder for IsIntervalInUnionOfOthers)
+// * The trace is written in the native byte order, records from different threads are interleaved whole
+//
+// Layout: "IVTR", uint32 version, uint8 sizeof(T), uint8 floating point, uint8 includes min, uint8 includes max, then
+// * Build: uint8 kind, uint64 fingerprint, uint64 count, count * {T min, T max}
+// * Contains & UnionContains: uint8 kind, uint64 fingerprint, T min, T max, uint8 result
+// * ContainsPoint: uint8 kind, uint64 fingerprint, T point, uint8 result
+// * ContainsPoints: uint8 kind, uint64 fingerprint, uint64 count, count * T point
+// Version 1 traces (before UnionContains) load as they are
+template <typename T, typename Boundary>
+class BasicQueryTraceRecorder {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    static constexpr std::uint32_t version = 2;
+
+    explicit BasicQueryTraceRecorder(const std::string &path) : _file(path, std::ios::binary | std::ios::trunc) {
+        if (!_file) {
+            ThrowOrAbort<std::runtime_error>("Can't open query trace " + path);
+        }
+
+        std::vector<char> header;
+        header.insert(header.end(), {'I', 'V', 'T', 'R'});
+        Put(header, version);
+        Put(header, std::uint8_t(sizeof(T)));
+        Put(header, std::uint8_t(std::is_floating_point_v<T>));
+        Put(header, std::uint8_t(Boundary::includesMin));
+        Put(header, std::uint8_t(Boundary::includesMax));
+        Write(header);
+    }
+
+    ~BasicQueryTraceRecorder() {
+        BasicQueryTraceRecorder *self = this;
+        _active.compare_exchange_strong(self, nullptr);
+    }
+
+    BasicQueryTraceRecorder(const BasicQueryTraceRecorder&) = delete;
+    BasicQueryTraceRecorder& operator = (const BasicQueryTraceRecorder&) = delete;
+
+    // Starts (or with nullptr stops) recording, the recorder has to outlive its installation
+    static void Install(BasicQueryTraceRecorder *recorder) {
+        _active.store(recorder, std::memory_order_release);
+    }
+
+    static BasicQueryTraceRecorder* Active() {
+        return _active.load(std::memory_order_acquire);
+    }
+
+    void RecordBuild(std::uint64_t fingerprint, const std::vector<IntervalType> &intervals) {
+        Write(BuildRecord(fingerprint, intervals));
+    }
+
+    // Records the collection as a build unless it already was, returns its fingerprint
+    std::uint64_t RecordCollection(const std::vector<IntervalType> &intervals) {
+        const std::uint64_t fingerprint = FingerprintIntervals(intervals);
+
+        // Note: checked & written under one lock, so no query on the collection can get written before it
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_collections.insert(fingerprint).second) {
+            const std::vector<char> record = BuildRecord(fingerprint, intervals);
+            _file.write(record.data(), static_cast<std::streamsize>(record.size()));
+        }
+        return fingerprint;
+    }
+
+    void RecordContains(std::uint64_t fingerprint, const IntervalType &interval, bool result) {
+        Write(IntervalRecord(TraceRecord::Contains, fingerprint, interval, result));
+    }
+
+    void RecordUnionContains(std::uint64_t fingerprint, const IntervalType &interval, bool result) {
+        Write(IntervalRecord(TraceRecord::UnionContains, fingerprint, interval, result));
+    }
+
+    void RecordContainsPoint(std::uint64_t fingerprint, T point, bool result) {
+        std::vector<char> record;
+        Put(record, TraceRecord::ContainsPoint);
+        Put(record, fingerprint);
+        Put(record, point);
+        Put(record, std::uint8_t(result));
+        Write(record);
+    }
+
+    void RecordContainsPoints(std::uint64_t fingerprint, const T *points, size_t count) {
+        std::vector<char> record;
+        Put(record, TraceRecord::ContainsPoints);
+        Put(record, fingerprint);
+        Put(record, std::uint64_t(count));
+        for (size_t i = 0; i < count; ++i) {
+            Put(record, points[i]);
+        }
+        Write(record);
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(_lock);
+        _file.flush();
+    }
+
+private:
+    template <typename Value>
+    static void Put(std::vector<char> &record, Value value) {
+        const size_t at = record.size();
+        record.resize(at + sizeof(Value));
+        std::memcpy(record.data() + at, &value, sizeof(Value));
+    }
+
+    static std::vector<char> BuildRecord(std::uint64_t fingerprint, const std::vector<IntervalType> &intervals) {
+        std::vector<char> record;
+        record.reserve(17 + intervals.size() * 2 * sizeof(T));
+        Put(record, TraceRecord::Build);
+        Put(record, fingerprint);
+        Put(record, std::uint64_t(intervals.size()));
+        for (const IntervalType &interval : intervals) {
+            Put(record, interval.Min());
+            Put(record, interval.Max());
+        }
+        return record;
+    }
+
+    static std::vector<char> IntervalRecord(TraceRecord kind, std::uint64_t fingerprint, const IntervalType &interval, bool result) {
+        std::vector<char> record;
+        Put(record, kind);
+        Put(record, fingerprint);
+        Put(record, interval.Min());
+        Put(record, interval.Max());
+        Put(record, std::uint8_t(result));
+        return record;
+    }
+
+    void Write(const std::vector<char> &record) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _file.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+
+    static inline std::atomic<BasicQueryTraceRecorder*> _active{nullptr};
+
+    std::mutex _lock;
+    std::ofstream _file;
+
+    // Fingerprints of the collections IsIntervalInUnionOfOthers was called with, already written as builds
+    std::set<std::uint64_t> _collections;
+};
+
+using QueryTraceRecorder = BasicQueryTraceRecorder<long int, Closed>;
+
+// A query trace loaded back into memory, see BasicQueryTraceRecorder for the format
+// * A trace cut short (e.g the traced process died) loads up to its last complete record
+template <typename T, typename Boundary = Closed>
+struct BasicQueryTrace {
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    struct Build {
+        std::uint64_t fingerprint;
+        std::vector<IntervalType> intervals;
+    };
+
+    // build indexes builds, for ContainsPoints the points are points[first, first + count)
+    struct Query {
+        TraceRecord kind;
+        size_t build;
+        T min;
+        T max;
+        bool result;
+        size_t first;
+        size_t count;
+    };
+
+    std::vector<Build> builds;
+    std::vector<Query> queries;
+    std::vector<T> points;
+
+    static BasicQueryTrace Load(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            ThrowOrAbort<std::runtime_error>("Can't open query trace " + path);
+        }
+
+        char magic[4] = {};
+        std::uint32_t traceVersion = 0;
+        std::uint8_t format[4] = {};
+        if (!Get(file, magic) || std::memcmp(magic, "IVTR", 4) != 0 || !Get(file, traceVersion) || !Get(file, format)) {
+            ThrowOrAbort<std::invalid_argument>("Not a query trace: " + path);
+        }
+
+        if (traceVersion == 0 || traceVersion > BasicQueryTraceRecorder<T, Boundary>::version || format[0] != sizeof(T) ||
+            format[1] != std::is_floating_point_v<T> || format[2] != Boundary::includesMin ||
+            format[3] != Boundary::includesMax) {
+            ThrowOrAbort<std::invalid_argument>("Query trace doesn't match the domain & boundary policy it's loaded as: " + path);
+        }
+
+        BasicQueryTrace trace;
+        std::map<std::uint64_t, size_t> builds;
+
+        for (;;) {
+            TraceRecord kind;
+            std::uint64_t fingerprint;
+            if (!Get(file, kind) || !Get(file, fingerprint)) {
+                break;
+            }
+
+            if (kind == TraceRecord::Build) {
+                std::uint64_t count;
+                if (!Get(file, count)) {
+                    break;
+                }
+
+                Build build{fingerprint, {}};
+                T bounds[2];
+                while (build.intervals.size() < count && Get(file, bounds)) {
+                    build.intervals.emplace_back(bounds[0], bounds[1]);
+                }
+                if (build.intervals.size() < count) {
+                    break;
+                }
+
+                builds[fingerprint] = trace.builds.size();
+                trace.builds.push_back(std::move(build));
+                continue;
+            }
+
+            const auto build = builds.find(fingerprint);
+            if (build == builds.end()) {
+                ThrowOrAbort<std::invalid_argument>("Query trace has a query on a collection it never built: " + path);
+            }
+
+            Query query{kind, build->second, T{}, T{}, false, 0, 0};
+            std::uint8_t result = 0;
+            bool complete;
+
+            switch (kind) {
+            case TraceRecord::Contains:
+            case TraceRecord::UnionContains:
+                complete = Get(file, query.min) && Get(file, query.max) && Get(file, result);
+                break;
+            case TraceRecord::ContainsPoint:
+                complete = Get(file, query.min) && Get(file, result);
+                query.max = query.min;
+                break;
+            case TraceRecord::ContainsPoints: {
+                std::uint64_t count;
+                complete = Get(file, count);
+                query.first = trace.points.size();
+                T point;
+                while (complete && query.count < count && (complete = Get(file, point))) {
+                    trace.points.push_back(point);
+                    ++query.count;
+                }
+                break;
+            }
+            default:
+                ThrowOrAbort<std::invalid_argument>("Query trace has a record of unknown kind: " + path);
+            }
+
+            if (!complete) {
+                trace.points.resize(query.first);
+                break;
+            }
+
+            query.result = (result != 0);
+            trace.queries.push_back(query);
+        }
+
+        return trace;
+    }
+
+private:
+    template <typename Value>
+    static bool Get(std::ifstream &file, Value &value) {
+        return static_cast<bool>(file.read(reinterpret_cast<char *>(&value), sizeof(Value)));
+    }
+};
+
+using QueryTrace = BasicQueryTrace<long int, Closed>;
+
+// What BasicCoverageIndex::ContainsPoints may assume about the order of the points it's given
+// * Unknown makes it check (one linear pass) and pick the matching path
+enum class PointOrder {
+    Unknown,
+    Sorted,
+    Unsorted
+};
+
+// Phases of a budgeted build (see BuildOptions), in the order they run
+enum class BuildPhase {
+    Sort,
+    Merge
+};
+
+// Lets another thread stop a long running build, which checks it between chunks & gives up with IntervalErrc::Cancelled
+class CancellationToken {
+public:
+    void Cancel() noexcept { _cancelled.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const noexcept { return _cancelled.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> _cancelled{false};
+};
+
+// Limits & hooks of a budgeted build, see SortAndMergeWithinBudget
+// * memoryBudget: bytes the build may allocate, the merged Intervals it produces included (its input isn't)
+// * spillDirectory: where the spill file goes if the build doesn't fit in memory, std::tmpfile's directory if empty
+// * progress: called between chunks with the phase, the Intervals done so far & the total
+// * cancellation: checked between chunks, nullptr if the build can't be cancelled
+// * chunkSize: Intervals per chunk, e.g how much work at most goes unchecked
+// * heatmapBuckets: if non-zero, the index also caches a heatmap of that many buckets over the span of its merged
+//   Intervals, from the Intervals it's built from (see BasicCoverageIndex::Heatmap) - not counted against the budget
+struct BuildOptions {
+    size_t memoryBudget = std::numeric_limits<size_t>::max();
+    std::string spillDirectory;
+    std::function<void(BuildPhase, size_t, size_t)> progress;
+    const CancellationToken *cancellation = nullptr;
+    size_t chunkSize = size_t(1) << 20;
+    size_t heatmapBuckets = 0;
+};
+
+// Temporary binary file of Intervals, removed when closed
+template <typename IntervalType>
+class SpillFile {
+    static_assert(std::is_trivially_copyable_v<IntervalType>, "Spilled Intervals are written as raw bytes");
+
+public:
+    explicit SpillFile(const std::string &directory) {
+        if (directory.empty()) {
+            _file = std::tmpfile();
+            return;
+        }
+
+        static std::atomic<unsigned> files{0};
+        _path = directory + "/intervals-spill-" + std::to_string(Clock::now().time_since_epoch().count()) + "-"
+              + std::to_string(files.fetch_add(1)) + ".tmp";
+        _file = std::fopen(_path.c_str(), "w+bx");
+    }
+
+    ~SpillFile() {
+        if (_file) {
+            std::fclose(_file);
+        }
+        if (!_path.empty()) {
+            std::remove(_path.c_str());
+        }
+    }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator = (const SpillFile&) = delete;
+
+    bool IsOpen() const { return _file != nullptr; }
+
+    // Appends the Intervals at the end of the file
+    bool Write(const IntervalType *intervals, size_t count) {
+        return std::fseek(_file, 0, SEEK_END) == 0 && std::fwrite(intervals, sizeof(IntervalType), count, _file) == count;
+    }
+
+    // Reads count Intervals starting with Interval number first
+    bool Read(size_t first, IntervalType *intervals, size_t count) {
+        return std::fseek(_file, static_cast<long>(first * sizeof(IntervalType)), SEEK_SET) == 0
+            && std::fread(intervals, sizeof(IntervalType), count, _file) == count;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::FILE *_file = nullptr;
+    std::string _path;
+};
+
+// Sorts & merges the Intervals into merged (as SortIntervals & MergeIntervals would) within options.memoryBudget
+// * The input is cut into runs that are sorted one by one, then merged with a k-way merge feeding straight into the
+//   merge of overlapping Intervals - so the work is split into chunks, with the progress reported & the cancellation
+//   checked between them
+// * The runs are kept in memory if they fit alongside the worst case merged output (every Interval disjoint), otherwise
+//   each is written to a spill file as soon as it's sorted & read back through small buffers during the merge - then
+//   only the merged Intervals have to fit, & IntervalErrc::OverBudget is returned if they don't (or if the budget is
+//   too small to hold a buffer for each run)
+// * Note: caches kept across builds (e.g the sorting networks) aren't counted against the budget
+template <typename T, typename Boundary>
+IntervalErrc SortAndMergeWithinBudget(const BasicInterval<T, Boundary> *intervals, size_t count, const BuildOptions &options,
+                                      std::vector<BasicInterval<T, Boundary>> &merged) {
+    typedef BasicInterval<T, Boundary> IntervalType;
+    constexpr size_t intervalBytes = sizeof(IntervalType);
+    const size_t chunk = std::max<size_t>(options.chunkSize, 1);
+    const size_t budget = options.memoryBudget / intervalBytes;
+
+    merged.clear();
+
+    // False if the build was cancelled
+    const auto checkpoint = [&](BuildPhase phase, size_t done) {
+        if (options.progress) {
+            options.progress(phase, done, count);
+        }
+        return !(options.cancellation && options.cancellation->IsCancelled());
+    };
+
+    // A run being merged: [at, last) is what's left of its current buffer, [next, end) what's left of it in the file
+    struct Cursor {
+        const IntervalType *at;
+        const IntervalType *last;
+        size_t next;
+        size_t end;
+        std::vector<IntervalType> buffer;
+    };
+
+    // Bookkeeping counted against the budget, in Intervals: the histograms of a radix sort (if runs can be long enough
+    // to get one) & a cursor with its heap entry per run being merged
+    const auto intervalsOf = [](size_t bytes) { return (bytes + intervalBytes - 1) / intervalBytes; };
+    const bool radixSorted = std::is_integral_v<T> && std::min(count, budget / 2) >= ActiveDispatchThresholds().radixSortMin;
+    const size_t sortBookkeeping = radixSorted ? intervalsOf(sizeof(T) * 256 * sizeof(size_t)) : 0;
+    const auto mergeBookkeeping = [&](size_t runs) { return intervalsOf(runs * (sizeof(Cursor) + sizeof(size_t))); };
+    const size_t sortBudget = budget > sortBookkeeping ? budget - sortBookkeeping : 0;
+
+    // In memory: the runs, a run being sorted (SortIntervals may need as much scratch) & the merged output, in Intervals
+    // * Runs are at least a chunk long & at most 64 of them, so the k-way merge stays shallow
+    const size_t memoryRun = std::min(count, std::max(chunk, count / 64 + 1));
+    const size_t memoryRuns = count ? (count + memoryRun - 1) / memoryRun : 0;
+    const bool inMemory = count <= sortBudget / 2 && 2 * count + memoryRun <= sortBudget
+                       && 2 * count + mergeBookkeeping(memoryRuns) <= budget;
+
+    // Spilled: a run & its sort scratch take the whole budget, the merge then splits it between the output & the buffers
+    const size_t runLength = inMemory ? memoryRun : std::max<size_t>(sortBudget / 2, 1);
+    const size_t runCount = count ? (count + runLength - 1) / runLength : 0;
+
+    // Spilled runs are read back a quarter of the budget at a time, the rest is for the merged output - which is reserved
+    // up front, so growing it never holds the old & the new buffer at once
+    const size_t mergeBudget = budget > mergeBookkeeping(runCount) ? budget - mergeBookkeeping(runCount) : 0;
+    const size_t bufferLength = std::min(runLength, std::max<size_t>(mergeBudget / 4 / std::max<size_t>(runCount, 1), 1));
+    const size_t maxMerged = inMemory ? count
+                           : std::min(count, mergeBudget > runCount * bufferLength ? mergeBudget - runCount * bufferLength : 0);
+    if (count && maxMerged == 0) {
+        return IntervalErrc::OverBudget;
+    }
+
+    std::vector<std::vector<IntervalType>> runs;
+    std::optional<SpillFile<IntervalType>> spill;
+    if (!inMemory) {
+        spill.emplace(options.spillDirectory);
+        if (!spill->IsOpen()) {
+            return IntervalErrc::SpillFailed;
+        }
+    }
+
+    if (!checkpoint(BuildPhase::Sort, 0)) {
+        return IntervalErrc::Cancelled;
+    }
+
+    std::vector<IntervalType> run;
+    for (size_t from = 0; from < count; from += runLength) {
+        run.assign(intervals + from, intervals + std::min(count, from + runLength));
+        SortIntervals(run);
+
+        if (inMemory) {
+            runs.push_back(std::move(run));
+            run = std::vector<IntervalType>();
+        }
+        else if (!spill->Write(run.data(), run.size())) {
+            return IntervalErrc::SpillFailed;
+        }
+
+        if (!checkpoint(BuildPhase::Sort, std::min(count, from + runLength))) {
+            return IntervalErrc::Cancelled;
+        }
+    }
+    run = std::vector<IntervalType>();
+
+    std::vector<Cursor> cursors(runCount);
+    for (size_t i = 0; i < runCount; ++i) {
+        Cursor &cursor = cursors[i];
+        if (inMemory) {
+            cursor.at = runs[i].data();
+            cursor.last = runs[i].data() + runs[i].size();
+            cursor.next = cursor.end = 0;
+        }
+        else {
+            cursor.at = cursor.last = nullptr;
+            cursor.next = i * runLength;
+            cursor.end = std::min(count, cursor.next + runLength);
+        }
+    }
+
+    // Moves the cursor to its next Interval, reading the next buffer of a spilled run when its current one runs out
+    const auto refill = [&](Cursor &cursor) {
+        if (cursor.at != cursor.last || cursor.next == cursor.end) {
+            return true;
+        }
+
+        const size_t length = std::min(bufferLength, cursor.end - cursor.next);
+        cursor.buffer.resize(length, IntervalType(T{}, T{}));
+        if (!spill->Read(cursor.next, cursor.buffer.data(), length)) {
+            return false;
+        }
+        cursor.next += length;
+        cursor.at = cursor.buffer.data();
+        cursor.last = cursor.at + length;
+        return true;
+    };
+
+    // Min-heap of the runs that aren't exhausted yet, by the Interval each is at
+    std::vector<size_t> heap;
+    heap.reserve(runCount);
+    const auto later = [&](size_t lhs, size_t rhs) { return *cursors[rhs].at < *cursors[lhs].at; };
+    for (size_t i = 0; i < runCount; ++i) {
+        if (!refill(cursors[i])) {
+            return IntervalErrc::SpillFailed;
+        }
+        if (cursors[i].at != cursors[i].last) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    merged.reserve(maxMerged);
+
+    size_t done = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Cursor &cursor = cursors[heap.back()];
+        const IntervalType next = *cursor.at++;
+
+        // The loop of MergeIntervals, one Interval at a time
+        if (!next.IsEmpty()) {
+            if (!merged.empty() && Boundary::Touches(merged.back().Max(), next.Min())) {
+                if (merged.back().Max() < next.Max()) {
+                    merged.back() = IntervalType::FromOrdered(merged.back().Min(), next.Max());
+                }
+            }
+            else {
+                if (merged.size() >= maxMerged) {
+                    merged = std::vector<IntervalType>();
+                    return IntervalErrc::OverBudget;
+                }
+                merged.push_back(next);
+            }
+        }
+
+        if (!refill(cursor)) {
+            return IntervalErrc::SpillFailed;
+        }
+        if (cursor.at != cursor.last) {
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+        else {
+            heap.pop_back();
+        }
+
+        if (++done % chunk == 0 && !checkpoint(BuildPhase::Merge, done)) {
+            return IntervalErrc::Cancelled;
+        }
+    }
+
+    return checkpoint(BuildPhase::Merge, count) ? IntervalErrc::Ok : IntervalErrc::Cancelled;
+}
+
+// Memory held by an index or set, in bytes of the allocations it owns (the object itself & the allocator's own
+// bookkeeping aren't included, except for sets storing their Intervals inline)
+// * boundaries: the Interval ends the answers come from
+// * searchLayout: structure that's only there to find them faster (tree nodes, block headers, links, shard table)
+// * auxiliary: summaries & buffers kept alongside (heatmaps, tag summaries, per-Interval entries, ingest ring)
+// * slack: allocated but holding nothing (unused vector capacity, partly filled blocks, retired nodes)
+// * inputCount / mergedCount: Intervals the structure was built from (or had inserted) & Intervals it keeps once
+//   merged, types that don't merge keep one entry per input Interval (or box) so their ratio is 1
+struct MemoryFootprint {
+    size_t boundaries = 0;
+    size_t searchLayout = 0;
+    size_t auxiliary = 0;
+    size_t slack = 0;
+
+    size_t inputCount = 0;
+    size_t mergedCount = 0;
+
+    size_t Total() const { return boundaries + searchLayout + auxiliary + slack; }
+
+    // How many input Intervals each kept one stands for, 1 for an empty structure
+    double CompressionRatio() const {
+        return mergedCount ? static_cast<double>(inputCount) / static_cast<double>(mergedCount) : 1.0;
+    }
+
+    // Adds the elements of the vector to part (one of the members above) & its unused capacity to slack
+    template <typename V>
+    void Add(size_t &part, const std::vector<V> &vector) {
+        part += vector.size() * sizeof(V);
+        slack += (vector.capacity() - vector.size()) * sizeof(V);
+    }
+};
+
+// Predecessor & successor queries over an unmerged collection of Intervals, answered with the position of the Interval
+// in the collection
+// * LastEndingBefore(x): the Interval with the latest end among the ones holding nothing at or past x
+// * FirstStartingAfter(x): the Interval with the earliest start among the ones holding nothing at or before x
+// * Both are binary searches over the ends sorted on their own (a sorted-by-max & a sorted-by-min array, each with the
+//   positions alongside) - O(log n). The batch variants search 4 points at once with AVX2 gathers & compares for 64-bit
+//   domains when built with AVX2 enabled (e.g -mavx2)
+// * Ties go to the Interval latest (LastEndingBefore) or earliest (FirstStartingAfter) in the collection, empty
+//   Intervals are never an answer & neither is anything for a NaN point
+template <typename T, typename Boundary = Closed>
+class BasicEndpointIndex {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    // Returned when there is no such Interval
+    static constexpr size_t noInterval = std::numeric_limits<size_t>::max();
+
+    BasicEndpointIndex() = default;
+
+    explicit BasicEndpointIndex(const std::vector<IntervalType> &intervals) : _inputCount(intervals.size()) {
+        std::vector<size_t> positions;
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (!intervals[i].IsEmpty()) {
+                positions.push_back(i);
+            }
+        }
+
+        _byMax = positions;
+        std::stable_sort(_byMax.begin(), _byMax.end(), [&intervals](size_t lhs, size_t rhs) {
+            return intervals[lhs].Max() < intervals[rhs].Max();
+        });
+        _byMin = std::move(positions);
+        std::stable_sort(_byMin.begin(), _byMin.end(), [&intervals](size_t lhs, size_t rhs) {
+            return intervals[lhs].Min() < intervals[rhs].Min();
+        });
+
+        _maxes.reserve(_byMax.size());
+        _mins.reserve(_byMin.size());
+        for (size_t i = 0; i < _byMax.size(); ++i) {
+            _maxes.push_back(intervals[_byMax[i]].Max());
+            _mins.push_back(intervals[_byMin[i]].Min());
+        }
+    }
+
+    size_t LastEndingBefore(T point) const noexcept {
+        if (IsNaN(point)) [[unlikely]] {
+            return noInterval;
+        }
+        return Predecessor(CountBelow<!Boundary::includesMax>(_maxes, point));
+    }
+
+    size_t FirstStartingAfter(T point) const noexcept {
+        if (IsNaN(point)) [[unlikely]] {
+            return noInterval;
+        }
+        return Successor(CountBelow<Boundary::includesMin>(_mins, point));
+    }
+
+    // LastEndingBefore / FirstStartingAfter of every one of the points, into positions[0, count)
+    void LastEndingBefore(const T *points, size_t count, size_t *positions) const noexcept {
+        Search<!Boundary::includesMax>(_maxes, points, count, positions);
+        for (size_t i = 0; i < count; ++i) {
+            positions[i] = IsNaN(points[i]) ? noInterval : Predecessor(positions[i]);
+        }
+    }
+
+    void FirstStartingAfter(const T *points, size_t count, size_t *positions) const noexcept {
+        Search<Boundary::includesMin>(_mins, points, count, positions);
+        for (size_t i = 0; i < count; ++i) {
+            positions[i] = IsNaN(points[i]) ? noInterval : Successor(positions[i]);
+        }
+    }
+
+    // Number of (non-empty) Intervals searched
+    size_t Size() const { return _maxes.size(); }
+
+    // The sorted ends are the boundaries, the positions next to them auxiliary - nothing is merged
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.boundaries, _maxes);
+        footprint.Add(footprint.boundaries, _mins);
+        footprint.Add(footprint.auxiliary, _byMax);
+        footprint.Add(footprint.auxiliary, _byMin);
+        footprint.inputCount = footprint.mergedCount = _inputCount;
+        return footprint;
+    }
+
+private:
+    static bool IsNaN([[maybe_unused]] T point) noexcept {
+        if constexpr (std::is_floating_point_v<T>) {
+            return std::isnan(point);
+        }
+        else {
+            return false;
+        }
+    }
+
+    // The Intervals ending before the point are the first count of _byMax, the latest of them is the answer
+    size_t Predecessor(size_t count) const noexcept {
+        return count ? _byMax[count - 1] : noInterval;
+    }
+
+    // The Intervals starting at or before the point are the first count of _byMin, the answer is the one right after
+    size_t Successor(size_t count) const noexcept {
+        return count < _byMin.size() ? _byMin[count] : noInterval;
+    }
+
+    // Number of keys below the point (OrEqual: at or below it) - lower_bound (upper_bound) without the unpredictable
+    // branch, the loop runs the same number of times for every point
+    template <bool OrEqual>
+    static size_t CountBelow(const std::vector<T> &keys, T point) noexcept {
+        if (keys.empty()) {
+            return 0;
+        }
+
+        const T *base = keys.data();
+        for (size_t length = keys.size(); length > 1;) {
+            const size_t half = length / 2;
+            base = Below<OrEqual>(base[half], point) ? base + half : base;
+            length -= half;
+        }
+
+        return static_cast<size_t>(base - keys.data()) + Below<OrEqual>(*base, point);
+    }
+
+    template <bool OrEqual>
+    static bool Below(T key, T point) noexcept {
+        return OrEqual ? key <= point : key < point;
+    }
+
+    // CountBelow of every one of the points into counts
+    template <bool OrEqual>
+    static void Search(const std::vector<T> &keys, const T *points, size_t count, size_t *counts) noexcept {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        if constexpr (sizeof(T) == 8 && (std::is_floating_point_v<T> || std::is_signed_v<T>)) {
+            if (!keys.empty()) {
+                for (; i + 4 <= count; i += 4) {
+                    CountBelowFour<OrEqual>(keys, points + i, counts + i);
+                }
+            }
+        }
+#endif
+
+        for (; i < count; ++i) {
+            counts[i] = CountBelow<OrEqual>(keys, points[i]);
+        }
+    }
+
+#if defined(__AVX2__)
+    // CountBelow for 4 points at once, the keys probed are gathered - every lane takes the same number of steps
+    template <bool OrEqual>
+    static void CountBelowFour(const std::vector<T> &keys, const T *points, size_t *counts) noexcept {
+        __m256i base = _mm256_setzero_si256();
+        __m256i below;
+
+        if constexpr (std::is_floating_point_v<T>) {
+            const double *data = keys.data();
+            const __m256d point = _mm256_loadu_pd(points);
+
+            for (size_t length = keys.size(); length > 1;) {
+                const size_t half = length / 2;
+                const __m256i probe = _mm256_add_epi64(base, _mm256_set1_epi64x(static_cast<long long>(half)));
+                const __m256d probed = _mm256_i64gather_pd(data, probe, 8);
+                const __m256d isBelow = _mm256_cmp_pd(probed, point, OrEqual ? _CMP_LE_OQ : _CMP_LT_OQ);
+                base = _mm256_blendv_epi8(base, probe, _mm256_castpd_si256(isBelow));
+                length -= half;
+            }
+
+            below = _mm256_castpd_si256(_mm256_cmp_pd(_mm256_i64gather_pd(data, base, 8), point,
+                                                      OrEqual ? _CMP_LE_OQ : _CMP_LT_OQ));
+        }
+        else {
+            const long long *data = reinterpret_cast<const long long *>(keys.data());
+            const __m256i point = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points));
+
+            // AVX2 only has a signed >, key < point is point > key & key <= point is the negation of key > point
+            const auto isBelow = [&point](__m256i probed) {
+                return OrEqual ? _mm256_xor_si256(_mm256_cmpgt_epi64(probed, point), _mm256_set1_epi64x(-1))
+                               : _mm256_cmpgt_epi64(point, probed);
+            };
+
+            for (size_t length = keys.size(); length > 1;) {
+                const size_t half = length / 2;
+                const __m256i probe = _mm256_add_epi64(base, _mm256_set1_epi64x(static_cast<long long>(half)));
+                base = _mm256_blendv_epi8(base, probe, isBelow(_mm256_i64gather_epi64(data, probe, 8)));
+                length -= half;
+            }
+
+            below = isBelow(_mm256_i64gather_epi64(data, base, 8));
+        }
+
+        // The compare masks are all ones (-1) where the key is below, so subtracting them adds 1
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(counts), _mm256_sub_epi64(base, below));
+    }
+#endif
+
+    std::vector<T> _maxes;
+    std::vector<size_t> _byMax;
+    std::vector<T> _mins;
+    std::vector<size_t> _byMin;
+    size_t _inputCount = 0;
+};
+
+using EndpointIndex = BasicEndpointIndex<long int, Closed>;
+
+// Sorted & merged collection of Intervals, built once and then queried many times
+// * IsIntervalInUnionOfOthers sorts and merges the whole collection on every call, the index does it once
+//   and answers each query with a binary search over the merged Intervals - O(log n) instead of O(n log n)
+// * Works for any domain & boundary policy the Interval does, the merging rules are the ones of MergeIntervals
+template <typename T, typename Boundary = Closed>
+class BasicCoverageIndex {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    BasicCoverageIndex() = default;
+
+    explicit BasicCoverageIndex(const std::vector<IntervalType> &intervals) : _inputCount(intervals.size()) {
+        SlowQueryLog::Timer timer(SlowQueryLog::Active());
+
+        std::vector<IntervalType> sorted(intervals);
+        SortIntervals(sorted);
+        timer.Mark("sort");
+
+        _merged = MergeIntervals(sorted);
+        timer.Mark("merge");
+
+        if (SlowQueryLog *log = timer.Slow()) [[unlikely]] {
+            log->Write<T, Boundary>("BasicCoverageIndex::Build", timer, nullptr, intervals);
+        }
+
+        TraceBuild(intervals);
+    }
+
+    // Builds the index within a memory budget, reporting progress & checking for cancellation between chunks
+    // * See SortAndMergeWithinBudget, errors (cancellation, budget, spill file) are returned rather than thrown
+    static IntervalExpected<BasicCoverageIndex> Build(const std::vector<IntervalType> &intervals, const BuildOptions &options) {
+        std::vector<IntervalType> merged;
+        if (const IntervalErrc error = SortAndMergeWithinBudget(intervals.data(), intervals.size(), options, merged);
+            error != IntervalErrc::Ok) {
+            return error;
+        }
+
+        BasicCoverageIndex index = FromMerged(std::move(merged));
+        index._inputCount = intervals.size();
+        if (options.heatmapBuckets > 0 && !index._merged.empty()) {
+            const IntervalType span = IntervalType::FromOrdered(index._merged.front().Min(), index._merged.back().Max());
+            index._heatmap = BuildCoverageHeatmap(intervals, index._merged, span, options.heatmapBuckets);
+        }
+        return index;
+    }
+
+    // Wraps Intervals that are already sorted & merged (e.g the output of MergeIntervals) without redoing either
+    static BasicCoverageIndex FromMerged(std::vector<IntervalType> merged) {
+        BasicCoverageIndex index;
+        index._merged = std::move(merged);
+        index._inputCount = index._merged.size();
+        index.TraceBuild(index._merged);
+        return index;
+    }
+
+    // Returns true if every element of the interval is contained in the union of the indexed Intervals
+    bool Contains(const IntervalType &interval) const {
+        SlowQueryLog::Timer timer(SlowQueryLog::Active());
+        const bool covered = IsCovered(interval);
+        timer.Mark("search");
+
+        if (SlowQueryLog *log = timer.Slow()) [[unlikely]] {
+            log->Write("BasicCoverageIndex::Contains", timer, &interval, _merged);
+        }
+
+        if (_traceId != 0) [[unlikely]] {
+            if (RecorderType *recorder = RecorderType::Active()) {
+                recorder->RecordContains(_traceId, interval, covered);
+            }
+        }
+
+        return covered;
+    }
+
+    // Returns true if the point is contained in any of the indexed Intervals
+    bool ContainsPoint(T point) const {
+        const auto it = FindLastStartingAtOrBefore(point);
+        const bool covered = (it != _merged.end() && Boundary::Contains(it->Min(), it->Max(), point));
+
+        if (_traceId != 0) [[unlikely]] {
+            if (RecorderType *recorder = RecorderType::Active()) {
+                recorder->RecordContainsPoint(_traceId, point, covered);
+            }
+        }
+
+        return covered;
+    }
+
+    // The exception-free queries, for code built with -fno-exceptions
+    // * Neither logged to the slow query log nor traced, as both do I/O that can fail
+    // * TryContains takes the ends rather than an Interval, so invalid ones (NaN) are reported rather than thrown
+    IntervalExpected<bool> TryContains(T min, T max) const noexcept {
+        const IntervalExpected<IntervalType> interval = IntervalType::Make(min, max);
+        if (!interval) [[unlikely]] {
+            return interval.Error();
+        }
+        return IsCovered(*interval);
+    }
+
+    IntervalExpected<bool> TryContainsPoint(T point) const noexcept {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (std::isnan(point)) [[unlikely]] {
+                return IntervalErrc::NotANumber;
+            }
+        }
+
+        const auto it = FindLastStartingAtOrBefore(point);
+        return (it != _merged.end() && Boundary::Contains(it->Min(), it->Max(), point));
+    }
+
+    // ContainsPoints into a bitmap of at least (count + 63) / 64 words provided by the caller, nothing is allocated
+    // * Returns IntervalErrc::NotANumber (with the bitmap untouched) if any of the points is NaN
+    IntervalErrc TryContainsPoints(const T *points, size_t count, std::uint64_t *bitmap,
+                                   PointOrder order = PointOrder::Unknown) const noexcept {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (std::any_of(points, points + count, [](T point) { return std::isnan(point); })) [[unlikely]] {
+                return IntervalErrc::NotANumber;
+            }
+        }
+
+        std::fill(bitmap, bitmap + (count + 63) / 64, std::uint64_t(0));
+        if (!_merged.empty() && count > 0) {
+            SearchPointsInOrder(points, count, bitmap, order);
+        }
+        return IntervalErrc::Ok;
+    }
+
+    // Checks every one of the points, bit i % 64 of word i / 64 of the returned bitmap is set if points[i] is covered
+    // * Sorted points are merge-joined with the merged Intervals - O(n + count)
+    // * Unsorted ones are binary-searched - O(count log n), with 64-bit domains searched 4 points at a time with AVX2
+    //   gathers & compares when built with AVX2 enabled (e.g -mavx2)
+    std::vector<std::uint64_t> ContainsPoints(const T *points, size_t count, PointOrder order = PointOrder::Unknown) const {
+        std::vector<std::uint64_t> bitmap((count + 63) / 64, 0);
+
+        if (_traceId != 0) [[unlikely]] {
+            if (RecorderType *recorder = RecorderType::Active()) {
+                recorder->RecordContainsPoints(_traceId, points, count);
+            }
+        }
+
+        if (_merged.empty() || count == 0) {
+            return bitmap;
+        }
+
+        SearchPointsInOrder(points, count, bitmap.data(), order);
+        return bitmap;
+    }
+
+    // Returns the heatmap cached by Build (see BuildOptions::heatmapBuckets), or nullptr if there is none
+    const CoverageHeatmap* Heatmap() const { return _heatmap ? &*_heatmap : nullptr; }
+
+    // Builds the predecessor / successor index of intervals (the ones the index was built from) and keeps it with the
+    // index, the positions it answers with are positions in intervals
+    // * Replaces the previously cached one, if any
+    const BasicEndpointIndex<T, Boundary>& CacheEndpoints(const std::vector<IntervalType> &intervals) {
+        _endpoints.emplace(intervals);
+        return *_endpoints;
+    }
+
+    // Returns the cached predecessor / successor index, or nullptr if there is none
+    const BasicEndpointIndex<T, Boundary>* Endpoints() const { return _endpoints ? &*_endpoints : nullptr; }
+
+    const std::vector<IntervalType>& Intervals() const { return _merged; }
+
+    size_t Size() const { return _merged.size(); }
+    bool Empty() const { return _merged.empty(); }
+
+    // Number of Intervals the index was built from, Size() of them are left once merged
+    size_t InputCount() const { return _inputCount; }
+
+    // The merged Intervals are searched as they are, so there's no separate search layout
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.boundaries, _merged);
+        if (_heatmap) {
+            footprint.Add(footprint.auxiliary, _heatmap->depth);
+            footprint.Add(footprint.auxiliary, _heatmap->coverage);
+        }
+        if (_endpoints) {
+            const MemoryFootprint endpoints = _endpoints->Footprint();
+            footprint.auxiliary += endpoints.boundaries + endpoints.searchLayout + endpoints.auxiliary;
+            footprint.slack += endpoints.slack;
+        }
+        footprint.inputCount = _inputCount;
+        footprint.mergedCount = _merged.size();
+        return footprint;
+    }
+
+private:
+    typedef BasicQueryTraceRecorder<T, Boundary> RecorderType;
+
+    bool IsCovered(const IntervalType &interval) const noexcept {
+        if (interval.IsEmpty()) {
+            return true;
+        }
+
+        // The merged Intervals neither overlap nor touch, so the only candidate is the last one starting at or before interval
+        const auto it = FindLastStartingAtOrBefore(interval.Min());
+        return (it != _merged.end() && interval.Max() <= it->Max());
+    }
+
+    // Logs the build inputs if a query trace is being recorded, & marks the index so its queries get logged too
+    void TraceBuild(const std::vector<IntervalType> &intervals) {
+        if (RecorderType *recorder = RecorderType::Active()) [[unlikely]] {
+            _traceId = FingerprintIntervals(_merged);
+            recorder->RecordBuild(_traceId, intervals);
+        }
+    }
+
+    void SearchPointsInOrder(const T *points, size_t count, std::uint64_t *bitmap, PointOrder order) const noexcept {
+        if (order == PointOrder::Unknown) {
+            order = std::is_sorted(points, points + count) ? PointOrder::Sorted : PointOrder::Unsorted;
+        }
+
+        if (order == PointOrder::Sorted) {
+            JoinSortedPoints(points, count, bitmap);
+        }
+        else {
+            SearchPoints(points, count, bitmap);
+        }
+    }
+
+    void JoinSortedPoints(const T *points, size_t count, std::uint64_t *bitmap) const noexcept {
+        // Number of merged Intervals starting at or before the current point, it only ever grows as the points do
+        size_t started = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            while (started < _merged.size() && _merged[started].Min() <= points[i]) {
+                ++started;
+            }
+
+            if (started > 0 && Boundary::Contains(_merged[started - 1].Min(), _merged[started - 1].Max(), points[i])) {
+                bitmap[i / 64] |= std::uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    void SearchPoints(const T *points, size_t count, std::uint64_t *bitmap) const noexcept {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        if constexpr (sizeof(T) == 8 && (std::is_floating_point_v<T> || std::is_signed_v<T>)) {
+            // Note: i stays a multiple of 4, so the 4 bits never straddle two words
+            for (; i + 4 <= count; i += 4) {
+                bitmap[i / 64] |= std::uint64_t(SearchFourPoints(points + i)) << (i % 64);
+            }
+        }
+#endif
+
+        for (; i < count; ++i) {
+            if (ContainsPointBranchless(points[i])) {
+                bitmap[i / 64] |= std::uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    // Binary search without the unpredictable branch - the loop runs the same number of times for every point
+    // * Ends at the last Interval starting at or before the point, or at the first one if there is none
+    bool ContainsPointBranchless(T point) const noexcept {
+        const IntervalType *base = _merged.data();
+
+        for (size_t length = _merged.size(); length > 1;) {
+            const size_t half = length / 2;
+            base = (base[half].Min() <= point) ? base + half : base;
+            length -= half;
+        }
+
+        return Boundary::Contains(base->Min(), base->Max(), point);
+    }
+
+#if defined(__AVX2__)
+    // ContainsPointBranchless for 4 points at once, the mins & maxes are gathered straight from the merged Intervals
+    // * Returns the 4 results as bits 0 - 3
+    unsigned SearchFourPoints(const T *points) const noexcept {
+        static_assert(sizeof(IntervalType) == 2 * sizeof(T), "Interval has to be laid out as a plain {min, max} pair");
+
+        if constexpr (std::is_floating_point_v<T>) {
+            const double *bounds = reinterpret_cast<const double *>(_merged.data());
+            const __m256d point = _mm256_loadu_pd(points);
+            __m256i base = _mm256_setzero_si256();
+
+            for (size_t length = _merged.size(); length > 1;) {
+                const size_t half = length / 2;
+                const __m256i probe = _mm256_add_epi64(base, _mm256_set1_epi64x(static_cast<long long>(half)));
+                const __m256d mins = _mm256_i64gather_pd(bounds, _mm256_slli_epi64(probe, 1), 8);
+                const __m256d pastPoint = _mm256_cmp_pd(mins, point, _CMP_GT_OQ);
+                base = _mm256_blendv_epi8(probe, base, _mm256_castpd_si256(pastPoint));
+                length -= half;
+            }
+
+            const __m256i minIndex = _mm256_slli_epi64(base, 1);
+            const __m256d mins = _mm256_i64gather_pd(bounds, minIndex, 8);
+            const __m256d maxs = _mm256_i64gather_pd(bounds, _mm256_add_epi64(minIndex, _mm256_set1_epi64x(1)), 8);
+
+            const __m256d aboveMin = _mm256_cmp_pd(mins, point, Boundary::includesMin ? _CMP_LE_OQ : _CMP_LT_OQ);
+            const __m256d belowMax = _mm256_cmp_pd(point, maxs, Boundary::includesMax ? _CMP_LE_OQ : _CMP_LT_OQ);
+
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_and_pd(aboveMin, belowMax)));
+        }
+        else {
+            const long long *bounds = reinterpret_cast<const long long *>(_merged.data());
+            const __m256i point = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(points));
+            __m256i base = _mm256_setzero_si256();
+
+            for (size_t length = _merged.size(); length > 1;) {
+                const size_t half = length / 2;
+                const __m256i probe = _mm256_add_epi64(base, _mm256_set1_epi64x(static_cast<long long>(half)));
+                const __m256i mins = _mm256_i64gather_epi64(bounds, _mm256_slli_epi64(probe, 1), 8);
+                const __m256i pastPoint = _mm256_cmpgt_epi64(mins, point);
+                base = _mm256_blendv_epi8(probe, base, pastPoint);
+                length -= half;
+            }
+
+            const __m256i minIndex = _mm256_slli_epi64(base, 1);
+            const __m256i mins = _mm256_i64gather_epi64(bounds, minIndex, 8);
+            const __m256i maxs = _mm256_i64gather_epi64(bounds, _mm256_add_epi64(minIndex, _mm256_set1_epi64x(1)), 8);
+
+            // AVX2 only has a signed >, so <= is the negation of it (andnot against all ones)
+            const __m256i ones = _mm256_set1_epi64x(-1);
+            const __m256i aboveMin = Boundary::includesMin ? _mm256_andnot_si256(_mm256_cmpgt_epi64(mins, point), ones)
+                                                           : _mm256_cmpgt_epi64(point, mins);
+            const __m256i belowMax = Boundary::includesMax ? _mm256_andnot_si256(_mm256_cmpgt_epi64(point, maxs), ones)
+                                                           : _mm256_cmpgt_epi64(maxs, point);
+
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(aboveMin, belowMax))));
+        }
+    }
+#endif
+
+    typename std::vector<IntervalType>::const_iterator FindLastStartingAtOrBefore(T value) const noexcept {
+        auto it = std::upper_bound(_merged.begin(), _merged.end(), value,
+                                   [](T value, const IntervalType &interval) { return value < interval.Min(); });
+
+        return (it == _merged.begin()) ? _merged.end() : std::prev(it);
+    }
+
+    std::vector<IntervalType> _merged;
+    std::optional<CoverageHeatmap> _heatmap;
+    std::optional<BasicEndpointIndex<T, Boundary>> _endpoints;
+    size_t _inputCount = 0;
+
+    // Fingerprint of _merged if the index was built while a query trace was being recorded, 0 otherwise
+    std::uint64_t _traceId = 0;
+};
+
+using CoverageIndex = BasicCoverageIndex<long int, Closed>;
+using RealCoverageIndex = BasicCoverageIndex<double, Closed>;
+
+// IsIntervalInUnionOfOthers for each of the targets against the same collection, result i is the answer for targets[i]
+// * A few targets are checked one by one, from DispatchThresholds::indexedQueriesMin on the collection is sorted &
+//   merged once into a BasicCoverageIndex & each target is a binary search
+template <typename T, typename Boundary>
+std::vector<bool> AreIntervalsInUnionOfOthers(const std::vector<BasicInterval<T, Boundary>> &targets,
+                                              const std::vector<BasicInterval<T, Boundary>> &intervals) {
+    std::vector<bool> covered(targets.size());
+
+    if (targets.size() < ActiveDispatchThresholds().indexedQueriesMin) {
+        for (size_t i = 0; i < targets.size(); ++i) {
+            covered[i] = IsIntervalInUnionOfOthers(targets[i], intervals);
+        }
+        return covered;
+    }
+
+    const BasicCoverageIndex<T, Boundary> index(intervals);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        covered[i] = index.Contains(targets[i]);
+    }
+    return covered;
+}
+
+// Segment tree over n positions supporting "add delta to a range of positions" and "min over a range of positions"
+// * Both in O(log n). The adds are kept at the nodes that cover the updated range rather than pushed down,
+//   so _min of a node is the min of its subtree including its own pending add
+// * Stored in flat arrays (node i has children 2i and 2i+1) for cache friendliness
+template <typename V>
+class RangeAddMinTree {
+public:
+    explicit RangeAddMinTree(size_t size, V initial = V()) : _size(size) {
+        size_t leaves = 1;
+        while (leaves < std::max<size_t>(size, 1)) {
+            leaves *= 2;
+        }
+
+        // Positions past size are padding - they get the max value so they never affect the min
+        _min.assign(2 * leaves, std::numeric_limits<V>::max());
+        _add.assign(2 * leaves, V());
+        _leaves = leaves;
+
+        for (size_t i = 0; i < size; ++i) {
+            _min[leaves + i] = initial;
+        }
+        for (size_t i = leaves - 1; i > 0; --i) {
+            _min[i] = std::min(_min[2 * i], _min[2 * i + 1]);
+        }
+    }
+
+    // Builds the tree straight from the values of the positions in O(n), rather than n Adds
+    explicit RangeAddMinTree(const std::vector<V> &values) : RangeAddMinTree(values.size()) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            _min[_leaves + i] = values[i];
+        }
+        for (size_t i = _leaves - 1; i > 0; --i) {
+            _min[i] = std::min(_min[2 * i], _min[2 * i + 1]);
+        }
+    }
+
+    size_t Size() const { return _size; }
+
+    // Both arrays are the tree, the padding leaves past Size() count as slack
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.searchLayout, _min);
+        footprint.Add(footprint.searchLayout, _add);
+
+        const size_t padding = 2 * (_leaves - std::min(_leaves, _size)) * sizeof(V);
+        footprint.searchLayout -= std::min(footprint.searchLayout, padding);
+        footprint.slack += padding;
+        return footprint;
+    }
+
+    // Adds delta to every position in [first, last]
+    void Add(size_t first, size_t last, V delta) {
+        Add(1, 0, _leaves - 1, first, last, delta);
+    }
+
+    // Returns the min over every position in [first, last]
+    V Min(size_t first, size_t last) const {
+        return Min(1, 0, _leaves - 1, first, last);
+    }
+
+    // Returns the min over all the positions
+    V Min() const { return _min[1]; }
+
+    // Returns the value of every position, in O(n)
+    std::vector<V> Values() const {
+        // Adds pending at the ancestors of each node, pushed down a level at a time
+        std::vector<V> above(2 * _leaves, V());
+        for (size_t node = 1; node < _leaves; ++node) {
+            above[2 * node] = above[2 * node + 1] = above[node] + _add[node];
+        }
+
+        std::vector<V> values(_size);
+        for (size_t i = 0; i < _size; ++i) {
+            values[i] = _min[_leaves + i] + above[_leaves + i];
+        }
+        return values;
+    }
+
+private:
+    void Add(size_t node, size_t nodeFirst, size_t nodeLast, size_t first, size_t last, V delta) {
+        if (last < nodeFirst || nodeLast < first) {
+            return;
+        }
+
+        if (first <= nodeFirst && nodeLast <= last) {
+            _add[node] += delta;
+            _min[node] += delta;
+            return;
+        }
+
+        const size_t middle = nodeFirst + (nodeLast - nodeFirst) / 2;
+        Add(2 * node, nodeFirst, middle, first, last, delta);
+        Add(2 * node + 1, middle + 1, nodeLast, first, last, delta);
+
+        _min[node] = std::min(_min[2 * node], _min[2 * node + 1]) + _add[node];
+    }
+
+    V Min(size_t node, size_t nodeFirst, size_t nodeLast, size_t first, size_t last) const {
+        if (last < nodeFirst || nodeLast < first) {
+            return std::numeric_limits<V>::max();
+        }
+
+        if (first <= nodeFirst && nodeLast <= last) {
+            return _min[node];
+        }
+
+        const size_t middle = nodeFirst + (nodeLast - nodeFirst) / 2;
+        const V childrenMin = std::min(Min(2 * node, nodeFirst, middle, first, last),
+                                       Min(2 * node + 1, middle + 1, nodeLast, first, last));
+
+        // Note: the padding (max value) must stay the max value, hence no add on top of it
+        return (childrenMin == std::numeric_limits<V>::max()) ? childrenMin : childrenMin + _add[node];
+    }
+
+    size_t _size = 0;
+    size_t _leaves = 1;
+    std::vector<V> _min;
+    std::vector<V> _add;
+};
+
+// Represents an axis-aligned rectangle as a pair of closed integer Intervals, one per axis
+template <typename T>
+class BasicRectangle {
+    static_assert(std::is_integral_v<T>, "Rectangle coverage relies on the integer +1 adjacency of closed Intervals");
+
+public:
+    typedef BasicInterval<T, Closed> IntervalType;
+
+    BasicRectangle(const IntervalType &x, const IntervalType &y) : _x(x), _y(y) {}
+
+    const IntervalType& X() const { return _x; }
+    const IntervalType& Y() const { return _y; }
+
+private:
+    IntervalType _x;
+    IntervalType _y;
+};
+
+using Rectangle = BasicRectangle<long int>;
+
+// Returns true if every element of the rectangle under test is contained in the union of the rectangles in the vector
+// * Sweeps over x with a coverage-count segment tree over the compressed y, so it's O(n log n) rather than quadratic
+// * The x axis is cut into strips at the points where the set of rectangles covering it changes, the rectangle under test
+//   is covered if every strip has a non-zero count at every compressed y - the sweep stops at the first strip that hasn't
+template <typename T>
+bool IsRectangleInUnionOfOthers(const BasicRectangle<T> &rectangle, const std::vector<BasicRectangle<T>> &rectangles) {
+    typedef typename BasicRectangle<T>::IntervalType IntervalType;
+
+    // Clip the rectangles to the one under test, the parts outside of it are irrelevant
+    std::vector<BasicRectangle<T>> clipped;
+    clipped.reserve(rectangles.size());
+
+    for (const BasicRectangle<T> &other : rectangles) {
+        const T xMin = std::max(other.X().Min(), rectangle.X().Min());
+        const T xMax = std::min(other.X().Max(), rectangle.X().Max());
+        const T yMin = std::max(other.Y().Min(), rectangle.Y().Min());
+        const T yMax = std::min(other.Y().Max(), rectangle.Y().Max());
+
+        if (xMin <= xMax && yMin <= yMax) {
+            clipped.emplace_back(IntervalType(xMin, xMax), IntervalType(yMin, yMax));
+        }
+    }
+
+    if (clipped.empty()) {
+        return false;
+    }
+
+    // The projections of the rectangles onto each axis have to cover the projection of the rectangle under test
+    // * It's a cheap (1-D merge) necessary condition - and a sufficient one if the rectangle is a single row or column,
+    //   as then all the clipped rectangles span the whole of the other axis
+    std::vector<IntervalType> xSlices, ySlices;
+    xSlices.reserve(clipped.size());
+    ySlices.reserve(clipped.size());
+
+    for (const BasicRectangle<T> &other : clipped) {
+        xSlices.push_back(other.X());
+        ySlices.push_back(other.Y());
+    }
+
+    if (!IsIntervalInUnionOfOthers(rectangle.X(), xSlices) || !IsIntervalInUnionOfOthers(rectangle.Y(), ySlices)) {
+        return false;
+    }
+
+    if (rectangle.X().Min() == rectangle.X().Max() || rectangle.Y().Min() == rectangle.Y().Max()) {
+        return true;
+    }
+
+    // Compress y into elementary segments, each identified by the y it starts at
+    // * A rectangle [a, b] starts a segment at a and ends one at b, so the next one starts at b + 1
+    //   (unless b is the max of the rectangle under test - which also guarantees b + 1 can't overflow)
+    std::vector<T> yStarts;
+    yStarts.reserve(2 * clipped.size() + 1);
+    yStarts.push_back(rectangle.Y().Min());
+
+    for (const BasicRectangle<T> &other : clipped) {
+        yStarts.push_back(other.Y().Min());
+        if (other.Y().Max() < rectangle.Y().Max()) {
+            yStarts.push_back(other.Y().Max() + 1);
+        }
+    }
+
+    std::sort(yStarts.begin(), yStarts.end());
+    yStarts.erase(std::unique(yStarts.begin(), yStarts.end()), yStarts.end());
+
+    const auto segmentOf = [&yStarts](T y) {
+        return static_cast<size_t>(std::upper_bound(yStarts.begin(), yStarts.end(), y) - yStarts.begin() - 1);
+    };
+
+    // Each rectangle adds 1 to the count of its y segments at its min x, and removes it right past its max x
+    struct Event {
+        T x;
+        int delta;
+        size_t first;
+        size_t last;
+    };
+
+    std::vector<Event> events;
+    events.reserve(2 * clipped.size());
+
+    for (const BasicRectangle<T> &other : clipped) {
+        const size_t first = segmentOf(other.Y().Min());
+        const size_t last = segmentOf(other.Y().Max());
+
+        events.push_back({other.X().Min(), +1, first, last});
+        if (other.X().Max() < rectangle.X().Max()) {
+            events.push_back({other.X().Max() + 1, -1, first, last});
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const Event &lhs, const Event &rhs) { return lhs.x < rhs.x; });
+
+    // Note: the x projection check above guarantees there is a rectangle starting at the min x of the one under test
+    RangeAddMinTree<long> counts(yStarts.size());
+
+    for (size_t i = 0; i < events.size();) {
+        const T x = events[i].x;
+
+        for (; i < events.size() && events[i].x == x; ++i) {
+            counts.Add(events[i].first, events[i].last, events[i].delta);
+        }
+
+        // The strip starting at x (and ending right before the next event) has an uncovered segment
+        if (counts.Min() <= 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Represents an axis-aligned box in Dimensions dimensions as a closed integer Interval per axis
+template <typename T, size_t Dimensions>
+class BasicBox {
+    static_assert(std::is_integral_v<T>, "Box coverage relies on the integer +1 adjacency of closed Intervals");
+    static_assert(Dimensions >= 1, "Box needs at least one axis");
+
+public:
+    typedef BasicInterval<T, Closed> IntervalType;
+
+    explicit BasicBox(const std::array<IntervalType, Dimensions> &axes) : _axes(axes) {}
+
+    const IntervalType& Axis(size_t axis) const { return _axes[axis]; }
+
+private:
+    std::array<IntervalType, Dimensions> _axes;
+};
+
+template <size_t Dimensions>
+using Box = BasicBox<long int, Dimensions>;
+
+// Prebuilt index answering repeated "is this box contained in the union of the boxes" queries
+// * The bounding box of the collection is recursively split (k-d tree style) at box boundaries, until each region is
+//   either covered by a single box or not touched by any - so the leaves decompose the space into disjoint covered
+//   and uncovered boxes. A query walks down the regions it intersects and fails at the first uncovered leaf
+// * Nodes are stored in a single flat vector in depth-first order: the left child of a node is the one right after it,
+//   the right child is at a relative offset - so subtrees are contiguous and can be built independently
+// * The top levels of the tree are built in parallel, one subtree per thread
+template <typename T, size_t Dimensions>
+class BasicBoxCoverageIndex {
+public:
+    typedef BasicBox<T, Dimensions> BoxType;
+
+    explicit BasicBoxCoverageIndex(const std::vector<BoxType> &boxes, unsigned threads = std::thread::hardware_concurrency()) {
+        if (boxes.empty()) {
+            _nodes.push_back(Node{T(), 0, 0, Node::uncovered});
+            return;
+        }
+
+        Region bounds = RegionOf(boxes.front());
+        for (const BoxType &box : boxes) {
+            for (size_t axis = 0; axis < Dimensions; ++axis) {
+                bounds.min[axis] = std::min(bounds.min[axis], box.Axis(axis).Min());
+                bounds.max[axis] = std::max(bounds.max[axis], box.Axis(axis).Max());
+            }
+        }
+        _bounds = bounds;
+        _inputCount = boxes.size();
+
+        std::vector<Region> regions;
+        regions.reserve(boxes.size());
+        for (const BoxType &box : boxes) {
+            regions.push_back(RegionOf(box));
+        }
+
+        // Each level of parallel recursion doubles the number of threads in use
+        unsigned parallelDepth = 0;
+        while ((1u << parallelDepth) < std::max(threads, 1u)) {
+            ++parallelDepth;
+        }
+
+        Build(_nodes, _bounds, regions, parallelDepth);
+    }
+
+    // Returns true if every element of the box is contained in the union of the indexed boxes
+    bool Contains(const BoxType &box) const {
+        const Region query = RegionOf(box);
+
+        // Anything outside of the bounding box is not covered
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            if (query.min[axis] < _bounds.min[axis] || _bounds.max[axis] < query.max[axis]) {
+                return false;
+            }
+        }
+
+        std::vector<size_t> pending;
+        pending.reserve(64);
+        pending.push_back(0);
+
+        while (!pending.empty()) {
+            const size_t index = pending.back();
+            pending.pop_back();
+
+            const Node &node = _nodes[index];
+
+            if (node.kind == Node::uncovered) {
+                return false;
+            }
+            if (node.kind == Node::covered) {
+                continue;
+            }
+
+            // Left child holds [min, split - 1], right one [split, max] along the axis
+            if (node.split <= query.max[node.axis]) {
+                pending.push_back(index + node.rightOffset);
+            }
+            if (query.min[node.axis] < node.split) {
+                pending.push_back(index + 1);
+            }
+        }
+
+        return true;
+    }
+
+    size_t NodeCount() const { return _nodes.size(); }
+
+    // The k-d tree is all there is, each node carrying one split coordinate - counted as search layout
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.searchLayout, _nodes);
+        footprint.inputCount = footprint.mergedCount = _inputCount;
+        return footprint;
+    }
+
+private:
+    struct Node {
+        enum Kind : std::uint8_t { inner, covered, uncovered };
+
+        T split;
+        std::uint32_t rightOffset;
+        std::uint8_t axis;
+        Kind kind;
+    };
+
+    struct Region {
+        std::array<T, Dimensions> min;
+        std::array<T, Dimensions> max;
+
+        bool Intersects(const Region &other) const {
+            for (size_t axis = 0; axis < Dimensions; ++axis) {
+                if (other.max[axis] < min[axis] || max[axis] < other.min[axis]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool Contains(const Region &other) const {
+            for (size_t axis = 0; axis < Dimensions; ++axis) {
+                if (other.min[axis] < min[axis] || max[axis] < other.max[axis]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    static Region RegionOf(const BoxType &box) {
+        Region region;
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            region.min[axis] = box.Axis(axis).Min();
+            region.max[axis] = box.Axis(axis).Max();
+        }
+        return region;
+    }
+
+    // Appends the subtree decomposing the region to nodes, boxes are the ones intersecting the region
+    static void Build(std::vector<Node> &nodes, const Region &region, const std::vector<Region> &boxes, unsigned parallelDepth) {
+        if (boxes.empty()) {
+            nodes.push_back(Node{T(), 0, 0, Node::uncovered});
+            return;
+        }
+
+        for (const Region &box : boxes) {
+            if (box.Contains(region)) {
+                nodes.push_back(Node{T(), 0, 0, Node::covered});
+                return;
+            }
+        }
+
+        // Neither covered nor empty, so at least one box has a boundary strictly inside the region
+        // * A boundary is where a box starts (min) or where it has just ended (max + 1), split at the median boundary
+        //   of the axis that has the most of them
+        size_t bestAxis = 0;
+        std::vector<T> bestBoundaries;
+
+        for (size_t axis = 0; axis < Dimensions; ++axis) {
+            std::vector<T> boundaries;
+            for (const Region &box : boxes) {
+                if (region.min[axis] < box.min[axis]) {
+                    boundaries.push_back(box.min[axis]);
+                }
+                if (box.max[axis] < region.max[axis]) {
+                    boundaries.push_back(box.max[axis] + 1);
+                }
+            }
+
+            if (boundaries.size() > bestBoundaries.size()) {
+                bestAxis = axis;
+                bestBoundaries.swap(boundaries);
+            }
+        }
+
+        auto median = bestBoundaries.begin() + bestBoundaries.size() / 2;
+        std::nth_element(bestBoundaries.begin(), median, bestBoundaries.end());
+        const T split = *median;
+
+        Region left = region, right = region;
+        left.max[bestAxis] = split - 1;
+        right.min[bestAxis] = split;
+
+        std::vector<Region> leftBoxes, rightBoxes;
+        for (const Region &box : boxes) {
+            if (box.Intersects(left)) {
+                leftBoxes.push_back(box);
+            }
+            if (box.Intersects(right)) {
+                rightBoxes.push_back(box);
+            }
+        }
+
+        const size_t index = nodes.size();
+        nodes.push_back(Node{split, 0, static_cast<std::uint8_t>(bestAxis), Node::inner});
+
+        if (parallelDepth > 0) {
+            // Build the left subtree on another thread, both subtrees are self-contained so they are simply appended
+            std::vector<Node> leftNodes, rightNodes;
+            auto leftBuilt = std::async(std::launch::async, [&]() { Build(leftNodes, left, leftBoxes, parallelDepth - 1); });
+            Build(rightNodes, right, rightBoxes, parallelDepth - 1);
+            leftBuilt.get();
+
+            nodes.insert(nodes.end(), leftNodes.begin(), leftNodes.end());
+            SetRightOffset(nodes, index);
+            nodes.insert(nodes.end(), rightNodes.begin(), rightNodes.end());
+        }
+        else {
+            Build(nodes, left, leftBoxes, 0);
+            std::vector<Region>().swap(leftBoxes);
+
+            SetRightOffset(nodes, index);
+            Build(nodes, right, rightBoxes, 0);
+        }
+
+        // Both halves ended up being leaves of the same kind - no point in keeping the split
+        const size_t rightIndex = index + nodes[index].rightOffset;
+        if (nodes.size() == index + 3 && nodes[index + 1].kind != Node::inner && nodes[index + 1].kind == nodes[rightIndex].kind) {
+            nodes[index] = nodes[index + 1];
+            nodes.resize(index + 1);
+        }
+    }
+
+    static void SetRightOffset(std::vector<Node> &nodes, size_t index) {
+        const size_t offset = nodes.size() - index;
+        if (offset > std::numeric_limits<std::uint32_t>::max()) [[unlikely]] {
+            ThrowOrAbort<std::length_error>("Box coverage index subtree too large");
+        }
+        nodes[index].rightOffset = static_cast<std::uint32_t>(offset);
+    }
+
+    Region _bounds{};
+    std::vector<Node> _nodes;
+    size_t _inputCount = 0;
+};
+
+template <size_t Dimensions>
+using BoxCoverageIndex = BasicBoxCoverageIndex<long int, Dimensions>;
+
+// Set of small non-negative integer tags (e.g region, owner or tier ids), stored as a bitset
+class TagSet {
+public:
+    TagSet() = default;
+
+    TagSet(std::initializer_list<size_t> tags) {
+        for (size_t tag : tags) {
+            Insert(tag);
+        }
+    }
+
+    void Insert(size_t tag) {
+        if (tag / 64 >= _words.size()) {
+            _words.resize(tag / 64 + 1, 0);
+        }
+        _words[tag / 64] |= std::uint64_t(1) << (tag % 64);
+    }
+
+    bool Contains(size_t tag) const {
+        return (tag / 64 < _words.size()) && ((_words[tag / 64] >> (tag % 64)) & 1);
+    }
+
+    const std::vector<std::uint64_t>& Words() const { return _words; }
+
+private:
+    std::vector<std::uint64_t> _words;
+};
+
+// Index answering "is the interval covered using only the Intervals with a tag in the given set" without any rebuild
+// * A segment tree over the elementary segments of the compressed coordinates - each Interval marks its tag on the
+//   O(log n) nodes its range decomposes into. The tags available at a point are the OR of the masks on its root-to-leaf path
+// * On top of that each node keeps two OR/AND-aggregated summaries of its subtree:
+//   * full - tags covering every point of the node's range on their own
+//   * any  - tags covering at least one point of it
+//   so a query stops descending as soon as the allowed tags are in "full" (covered) or not in "any" (not covered)
+// * Queries run in O(log n * words) when the summaries decide, which is the case unless the coverage of the allowed
+//   tags is stitched together from many differently tagged pieces - then it's bounded by the number of those pieces
+// * Integral domains only, Intervals of any boundary policy are converted to their closed equivalent
+template <typename T, typename Boundary = Closed>
+class BasicTaggedCoverageIndex {
+    static_assert(std::is_integral_v<T>, "Tagged coverage relies on elementary integer segments");
+
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    // tags[i] is the tag of intervals[i]
+    BasicTaggedCoverageIndex(const std::vector<IntervalType> &intervals, const std::vector<size_t> &tags) {
+        if (intervals.size() != tags.size()) {
+            ThrowOrAbort<std::invalid_argument>("Expecting exactly one tag per Interval");
+        }
+
+        _inputCount = intervals.size();
+
+        // Elementary segments start at the first element of an Interval, or right past the last one
+        size_t maxTag = 0;
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (intervals[i].IsEmpty()) {
+                continue;
+            }
+
+            const T last = Boundary::LastElement(intervals[i].Max());
+            _starts.push_back(Boundary::FirstElement(intervals[i].Min()));
+            if (last < std::numeric_limits<T>::max()) {
+                _starts.push_back(last + 1);
+            }
+            maxTag = std::max(maxTag, tags[i]);
+        }
+
+        std::sort(_starts.begin(), _starts.end());
+        _starts.erase(std::unique(_starts.begin(), _starts.end()), _starts.end());
+
+        _words = maxTag / 64 + 1;
+        _leaves = 1;
+        while (_leaves < std::max<size_t>(_starts.size(), 1)) {
+            _leaves *= 2;
+        }
+
+        _masks.assign(2 * _leaves * _words, 0);
+
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (intervals[i].IsEmpty()) {
+                continue;
+            }
+
+            const size_t first = SegmentOf(Boundary::FirstElement(intervals[i].Min()));
+            const size_t last = SegmentOf(Boundary::LastElement(intervals[i].Max()));
+            Mark(1, 0, _leaves - 1, first, last, tags[i]);
+        }
+
+        // Padding leaves (past the last segment) are never queried, "full" of all ones keeps them out of the ANDs
+        _full.assign(2 * _leaves * _words, 0);
+        _any.assign(2 * _leaves * _words, 0);
+
+        for (size_t leaf = 0; leaf < _leaves; ++leaf) {
+            for (size_t w = 0; w < _words; ++w) {
+                const size_t at = (_leaves + leaf) * _words + w;
+                _full[at] = (leaf < _starts.size()) ? _masks[at] : ~std::uint64_t(0);
+                _any[at] = _masks[at];
+            }
+        }
+
+        for (size_t node = _leaves - 1; node > 0; --node) {
+            for (size_t w = 0; w < _words; ++w) {
+                const size_t at = node * _words + w;
+                _full[at] = _masks[at] | (_full[2 * node * _words + w] & _full[(2 * node + 1) * _words + w]);
+                _any[at] = _masks[at] | _any[2 * node * _words + w] | _any[(2 * node + 1) * _words + w];
+            }
+        }
+    }
+
+    // Returns true if every element of the interval is contained in the union of the Intervals tagged with any of allowed
+    bool Contains(const IntervalType &interval, const TagSet &allowed) const {
+        if (interval.IsEmpty()) {
+            return true;
+        }
+
+        const T first = Boundary::FirstElement(interval.Min());
+        const T last = Boundary::LastElement(interval.Max());
+
+        if (_starts.empty() || first < _starts.front()) {
+            return false;
+        }
+
+        return Covered(1, 0, _leaves - 1, SegmentOf(first), SegmentOf(last), allowed.Words());
+    }
+
+    // The segment starts are the boundaries, the tag masks the tree & full / any its summaries
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.boundaries, _starts);
+        footprint.Add(footprint.searchLayout, _masks);
+        footprint.Add(footprint.auxiliary, _full);
+        footprint.Add(footprint.auxiliary, _any);
+        footprint.inputCount = footprint.mergedCount = _inputCount;
+        return footprint;
+    }
+
+private:
+    size_t SegmentOf(T value) const {
+        return static_cast<size_t>(std::upper_bound(_starts.begin(), _starts.end(), value) - _starts.begin() - 1);
+    }
+
+    void Mark(size_t node, size_t nodeFirst, size_t nodeLast, size_t first, size_t last, size_t tag) {
+        if (last < nodeFirst || nodeLast < first) {
+            return;
+        }
+
+        if (first <= nodeFirst && nodeLast <= last) {
+            _masks[node * _words + tag / 64] |= std::uint64_t(1) << (tag % 64);
+            return;
+        }
+
+        const size_t middle = nodeFirst + (nodeLast - nodeFirst) / 2;
+        Mark(2 * node, nodeFirst, middle, first, last, tag);
+        Mark(2 * node + 1, middle + 1, nodeLast, first, last, tag);
+    }
+
+    bool Intersects(const std::uint64_t *tags, const std::vector<std::uint64_t> &allowed) const {
+        const size_t words = std::min(_words, allowed.size());
+        for (size_t w = 0; w < words; ++w) {
+            if (tags[w] & allowed[w]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Note: the tags of the ancestors never need carrying down - the descent only gets here when none of them is
+    // allowed, so the node's own mask alone decides whether the tags on its path are
+    bool Covered(size_t node, size_t nodeFirst, size_t nodeLast, size_t first, size_t last,
+                 const std::vector<std::uint64_t> &allowed) const {
+        if (last < nodeFirst || nodeLast < first) {
+            return true;
+        }
+
+        if (Intersects(&_masks[node * _words], allowed)) {
+            return true;
+        }
+
+        if (first <= nodeFirst && nodeLast <= last) {
+            if (Intersects(&_full[node * _words], allowed)) {
+                return true;
+            }
+            if (!Intersects(&_any[node * _words], allowed)) {
+                return false;
+            }
+        }
+
+        // Note: a leaf is always decided above, as its full & any are both just its own mask
+        const size_t middle = nodeFirst + (nodeLast - nodeFirst) / 2;
+        return Covered(2 * node, nodeFirst, middle, first, last, allowed) &&
+               Covered(2 * node + 1, middle + 1, nodeLast, first, last, allowed);
+    }
+
+    std::vector<T> _starts;
+    size_t _words = 1;
+    size_t _leaves = 1;
+    std::vector<std::uint64_t> _masks;
+    std::vector<std::uint64_t> _full;
+    std::vector<std::uint64_t> _any;
+    size_t _inputCount = 0;
+};
+
+using TaggedCoverageIndex = BasicTaggedCoverageIndex<long int, Closed>;
+
+// Index answering "does every point of the interval have a total weight of at least w" over weighted Intervals
+// * Keeps the total weight of each elementary segment of the compressed coordinates in a RangeAddMinTree, so a query
+//   is a range min in O(log n) and adding / removing a weighted Interval is a range add in O(log n)
+// * Adding an Interval with an end that isn't one of the compressed coordinates yet would split a segment, so it's
+//   kept aside in a short sorted pending list that queries fold in - the segments are split & the tree rebuilt (O(n))
+//   only once the list fills up, i.e once per batch of such Adds rather than on each of them
+// * Reserve the ends of Intervals that are known ahead of time to keep their Adds at O(log n) throughout
+// * Integral domains only, Intervals of any boundary policy are converted to their closed equivalent
+template <typename T, typename Boundary = Closed, typename W = long int>
+class BasicWeightedCoverageIndex {
+    static_assert(std::is_integral_v<T>, "Weighted coverage relies on elementary integer segments");
+
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    BasicWeightedCoverageIndex() : _weights(0) {}
+
+    // weights[i] is the weight of intervals[i]
+    BasicWeightedCoverageIndex(const std::vector<IntervalType> &intervals, const std::vector<W> &weights) : _weights(0) {
+        if (intervals.size() != weights.size()) {
+            ThrowOrAbort<std::invalid_argument>("Expecting exactly one weight per Interval");
+        }
+
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (!intervals[i].IsEmpty()) {
+                Entry &entry = _intervals[{Boundary::FirstElement(intervals[i].Min()), Boundary::LastElement(intervals[i].Max())}];
+                entry.weight += weights[i];
+                ++entry.count;
+            }
+        }
+
+        Rebuild();
+    }
+
+    // Makes the ends of the intervals compressed coordinates ahead of their Adds, rebuilding the tree once
+    void Reserve(const std::vector<IntervalType> &intervals) {
+        for (const IntervalType &interval : intervals) {
+            if (!interval.IsEmpty()) {
+                const T last = Boundary::LastElement(interval.Max());
+                _reserved.push_back(Boundary::FirstElement(interval.Min()));
+                if (last < std::numeric_limits<T>::max()) {
+                    _reserved.push_back(last + 1);
+                }
+            }
+        }
+
+        std::sort(_reserved.begin(), _reserved.end());
+        _reserved.erase(std::unique(_reserved.begin(), _reserved.end()), _reserved.end());
+
+        Rebuild();
+    }
+
+    void Add(const IntervalType &interval, W weight) {
+        if (interval.IsEmpty()) {
+            return;
+        }
+
+        const T first = Boundary::FirstElement(interval.Min());
+        const T last = Boundary::LastElement(interval.Max());
+
+        Entry &entry = _intervals[{first, last}];
+        entry.weight += weight;
+        ++entry.count;
+
+        Apply(first, last, weight);
+    }
+
+    // Removes weight previously added for the very same Interval
+    // * The entry of an Interval goes once all of its Adds are removed, which must take away exactly the weight they
+    //   added - removing the last one with any other weight is rejected & leaves the index as it was
+    void Remove(const IntervalType &interval, W weight) {
+        if (interval.IsEmpty()) {
+            return;
+        }
+
+        const T first = Boundary::FirstElement(interval.Min());
+        const T last = Boundary::LastElement(interval.Max());
+
+        auto it = _intervals.find({first, last});
+        if (it == _intervals.end()) {
+            ThrowOrAbort<std::invalid_argument>("Attempting to remove an Interval that was never added");
+        }
+        if (it->second.count == 1 && it->second.weight != weight) {
+            ThrowOrAbort<std::invalid_argument>("Attempting to remove a weight the Interval was never added with");
+        }
+
+        it->second.weight -= weight;
+        if (--it->second.count == 0) {
+            _intervals.erase(it);
+        }
+
+        // Note: the compressed coordinates are left as they are, a segment boundary nothing ends at does no harm
+        Apply(first, last, -weight);
+    }
+
+    // Returns the smallest total weight of any element of the interval (0 for the elements not in any of the Intervals)
+    W MinWeight(const IntervalType &interval) const {
+        if (interval.IsEmpty()) {
+            return std::numeric_limits<W>::max();
+        }
+
+        const T first = Boundary::FirstElement(interval.Min());
+        const T last = Boundary::LastElement(interval.Max());
+
+        if (_pendingStarts.empty()) {
+            return TreeMinWeight(first, last);
+        }
+
+        // The pending weight is constant between consecutive pending ends, so the interval is split at them &
+        // each piece is a tree query plus the pending weight over it
+        size_t start = 0;
+        size_t end = 0;
+        W pending = W();
+        while (start < _pendingStarts.size() && _pendingStarts[start].first <= first) {
+            pending += _pendingStarts[start++].second;
+        }
+        while (end < _pendingEnds.size() && _pendingEnds[end].first <= first) {
+            pending -= _pendingEnds[end++].second;
+        }
+
+        W min = std::numeric_limits<W>::max();
+        T pieceFirst = first;
+        while (true) {
+            const bool startsNext = start < _pendingStarts.size() && _pendingStarts[start].first <= last;
+            const bool endsNext = end < _pendingEnds.size() && _pendingEnds[end].first <= last;
+            if (!startsNext && !endsNext) {
+                break;
+            }
+
+            const T next = (startsNext && (!endsNext || _pendingStarts[start].first < _pendingEnds[end].first))
+                         ? _pendingStarts[start].first
+                         : _pendingEnds[end].first;
+            min = std::min(min, TreeMinWeight(pieceFirst, next - 1) + pending);
+
+            while (start < _pendingStarts.size() && _pendingStarts[start].first == next) {
+                pending += _pendingStarts[start++].second;
+            }
+            while (end < _pendingEnds.size() && _pendingEnds[end].first == next) {
+                pending -= _pendingEnds[end++].second;
+            }
+            pieceFirst = next;
+        }
+
+        return std::min(min, TreeMinWeight(pieceFirst, last) + pending);
+    }
+
+    // Returns true if every element of the interval has a total weight of at least minWeight
+    bool Contains(const IntervalType &interval, W minWeight) const {
+        return MinWeight(interval) >= minWeight;
+    }
+
+    // The segment starts are the boundaries, the weight tree the search layout & the per-Interval entries (kept for
+    // rebuilds), reserved coordinates & pending Adds auxiliary - each map node estimated as its value plus the colour
+    // & 3 links of a red-black tree node
+    // * Identical Intervals share an entry, which is what mergedCount counts
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint = _weights.Footprint();
+        footprint.Add(footprint.boundaries, _starts);
+        footprint.auxiliary += _intervals.size() * (sizeof(typename decltype(_intervals)::value_type) + 4 * sizeof(void *));
+        footprint.Add(footprint.auxiliary, _reserved);
+        footprint.Add(footprint.auxiliary, _pendingStarts);
+        footprint.Add(footprint.auxiliary, _pendingEnds);
+
+        for (const auto &[bounds, entry] : _intervals) {
+            footprint.inputCount += entry.count;
+        }
+        footprint.mergedCount = _intervals.size();
+        return footprint;
+    }
+
+private:
+    bool IsSegmentStart(T value) const {
+        return std::binary_search(_starts.begin(), _starts.end(), value);
+    }
+
+    size_t SegmentOf(T value) const {
+        return static_cast<size_t>(std::upper_bound(_starts.begin(), _starts.end(), value) - _starts.begin() - 1);
+    }
+
+    // Largest number of pending Adds before a rebuild, trading the cost of folding them into queries against how
+    // often the O(n log n) rebuild runs
+    size_t PendingLimit() const {
+        return std::clamp<size_t>(static_cast<size_t>(std::sqrt(static_cast<double>(_starts.size()))), 16, 256);
+    }
+
+    // Adds weight to [first, last] in the tree, or to the pending lists when either end would split a segment
+    void Apply(T first, T last, W weight) {
+        const bool endsInside = (last < std::numeric_limits<T>::max() && !IsSegmentStart(last + 1));
+        if (IsSegmentStart(first) && !endsInside) {
+            _weights.Add(SegmentOf(first), SegmentOf(last), weight);
+            return;
+        }
+
+        const std::pair<T, W> start(first, weight);
+        _pendingStarts.insert(std::upper_bound(_pendingStarts.begin(), _pendingStarts.end(), start, ByCoordinate), start);
+        if (last < std::numeric_limits<T>::max()) {
+            const std::pair<T, W> end(last + 1, weight);
+            _pendingEnds.insert(std::upper_bound(_pendingEnds.begin(), _pendingEnds.end(), end, ByCoordinate), end);
+        }
+
+        if (_pendingStarts.size() >= PendingLimit()) {
+            // Segment starts nothing ends at any more pile up with Removes, a full rebuild from the entries drops them
+            if (_starts.size() > 4 * (_intervals.size() + _reserved.size()) + 64) {
+                Rebuild();
+            }
+            else {
+                FoldPending();
+            }
+        }
+    }
+
+    // Splits the segments at the pending ends & adds the pending weights to them in O(n + k log k), rather than
+    // recompressing every entry
+    void FoldPending() {
+        const std::vector<W> values = _weights.Values();
+        const std::vector<T> previous = std::move(_starts);
+
+        _starts.clear();
+        _starts.reserve(previous.size() + _pendingStarts.size() + _pendingEnds.size());
+
+        // Three sorted runs - the previous starts & both pending lists - merged in one pass
+        size_t start = 0;
+        size_t end = 0;
+        size_t kept = 0;
+        while (kept < previous.size() || start < _pendingStarts.size() || end < _pendingEnds.size()) {
+            T next = std::numeric_limits<T>::max();
+            if (kept < previous.size()) {
+                next = previous[kept];
+            }
+            if (start < _pendingStarts.size()) {
+                next = std::min(next, _pendingStarts[start].first);
+            }
+            if (end < _pendingEnds.size()) {
+                next = std::min(next, _pendingEnds[end].first);
+            }
+
+            if (_starts.empty() || _starts.back() != next) {
+                _starts.push_back(next);
+            }
+            kept += (kept < previous.size() && previous[kept] == next);
+            start += (start < _pendingStarts.size() && _pendingStarts[start].first == next);
+            end += (end < _pendingEnds.size() && _pendingEnds[end].first == next);
+        }
+
+        // A new segment carries the weight of the previous segment it lies in (nothing before the first one)
+        std::vector<W> totals(_starts.size(), W());
+        size_t at = 0;
+        for (size_t i = 0; i < _starts.size(); ++i) {
+            while (at < previous.size() && previous[at] <= _starts[i]) {
+                ++at;
+            }
+            totals[i] = (at > 0) ? values[at - 1] : W();
+        }
+
+        // Then the pending Adds on top, as a difference array
+        std::vector<W> differences(_starts.size() + 1, W());
+        for (const auto &[coordinate, weight] : _pendingStarts) {
+            differences[SegmentOf(coordinate)] += weight;
+        }
+        for (const auto &[coordinate, weight] : _pendingEnds) {
+            differences[SegmentOf(coordinate)] -= weight;
+        }
+
+        W pending = W();
+        for (size_t i = 0; i < _starts.size(); ++i) {
+            pending += differences[i];
+            totals[i] += pending;
+        }
+
+        _weights = RangeAddMinTree<W>(totals);
+        _pendingStarts.clear();
+        _pendingEnds.clear();
+    }
+
+    static bool ByCoordinate(const std::pair<T, W> &lhs, const std::pair<T, W> &rhs) {
+        return lhs.first < rhs.first;
+    }
+
+    // Smallest weight in the tree over [first, last]
+    W TreeMinWeight(T first, T last) const {
+        if (_starts.empty() || last < _starts.front()) {
+            return W();
+        }
+
+        // Whatever is before the first segment isn't in any of the Intervals
+        const W before = (first < _starts.front()) ? W() : std::numeric_limits<W>::max();
+        const size_t firstSegment = (first < _starts.front()) ? 0 : SegmentOf(first);
+
+        return std::min(before, _weights.Min(firstSegment, SegmentOf(last)));
+    }
+
+    // Recompresses the coordinates and rebuilds the tree from a difference array over the segments, which takes in
+    // the pending Adds as well
+    void Rebuild() {
+        _starts.clear();
+        for (const auto &[bounds, entry] : _intervals) {
+            _starts.push_back(bounds.first);
+            if (bounds.second < std::numeric_limits<T>::max()) {
+                _starts.push_back(bounds.second + 1);
+            }
+        }
+        _starts.insert(_starts.end(), _reserved.begin(), _reserved.end());
+
+        std::sort(_starts.begin(), _starts.end());
+        _starts.erase(std::unique(_starts.begin(), _starts.end()), _starts.end());
+
+        std::vector<W> totals(_starts.size() + 1, W());
+        for (const auto &[bounds, entry] : _intervals) {
+            totals[SegmentOf(bounds.first)] += entry.weight;
+            totals[SegmentOf(bounds.second) + 1] -= entry.weight;
+        }
+
+        for (size_t i = 1; i < totals.size(); ++i) {
+            totals[i] += totals[i - 1];
+        }
+        totals.pop_back();
+
+        _weights = RangeAddMinTree<W>(totals);
+        _pendingStarts.clear();
+        _pendingEnds.clear();
+    }
+
+    // Total weight & number of Intervals per exact closed Interval, the tree is rebuilt from it when the coordinates change
+    struct Entry {
+        W weight = W();
+        size_t count = 0;
+    };
+
+    std::map<std::pair<T, T>, Entry> _intervals;
+    std::vector<T> _reserved;    // Segment starts kept across rebuilds, see Reserve
+    std::vector<T> _starts;
+    RangeAddMinTree<W> _weights;
+
+    // Weight added from / removed right past each pending Add, sorted by coordinate
+    std::vector<std::pair<T, W>> _pendingStarts;
+    std::vector<std::pair<T, W>> _pendingEnds;
+};
+
+using WeightedCoverageIndex = BasicWeightedCoverageIndex<long int, Closed, long int>;
+
+// Bounded lock-free ring buffer for any number of producers and a single consumer
+// * Every slot carries a sequence number telling whether it's free for the producer at a given position or holds an
+//   item for the consumer at it (D. Vyukov's bounded queue) - a push is a single CAS on the tail, a pop needs none
+// * Capacity is rounded up to a power of 2
+template <typename Item>
+class BoundedRing {
+    static_assert(std::is_trivially_copyable_v<Item>, "Ring slots hold raw copies of the items");
+
+public:
+    explicit BoundedRing(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+
+        _slots = std::make_unique<Slot[]>(size);
+        _mask = size - 1;
+
+        for (size_t i = 0; i < size; ++i) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Capacity() const { return _mask + 1; }
+
+    // Bytes of the slots
+    size_t Bytes() const { return Capacity() * sizeof(Slot); }
+
+    // Returns false if the ring is full
+    bool TryPush(const Item &item) {
+        size_t position = _tail.load(std::memory_order_relaxed);
+        Slot *slot;
+
+        for (;;) {
+            slot = &_slots[position & _mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+
+            if (difference == 0) {
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (slot->storage) Item(item);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the ring is empty, must only ever be called from a single thread
+    bool TryPop(Item &item) {
+        const size_t position = _head.load(std::memory_order_relaxed);
+        Slot &slot = _slots[position & _mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+
+        item = *std::launder(reinterpret_cast<Item *>(slot.storage));
+        slot.sequence.store(position + _mask + 1, std::memory_order_release);
+        _head.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(Item) unsigned char storage[sizeof(Item)];
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask = 0;
+
+    // Producers & the consumer hammer different ends, keep them on separate cache lines
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) std::atomic<size_t> _head{0};
+};
+
+// Throughput counters of an IntervalIngestor, all totals since it was created
+struct IngestStats {
+    size_t pushed = 0;          // Intervals accepted into the ring
+    size_t rejected = 0;        // TryPush calls that found the ring full
+    size_t stalls = 0;          // Push calls that had to wait for the builder to make room
+    size_t batches = 0;         // Batches merged into the live set
+    size_t merged = 0;          // Intervals drained from the ring & merged into the live set
+    size_t liveIntervals = 0;   // Size of the currently published (merged) set
+};
+
+// Collects Intervals from any number of producer threads and keeps a live, merged index of all of them
+// * Producers push into a BoundedRing - no locks, a full ring pushes back (TryPush fails, Push waits)
+// * A builder thread drains the ring in batches, sorts & merges each batch and merges it into the live set, which is
+//   then published as an immutable BasicCoverageIndex - readers grab the current one with Snapshot() and never wait
+template <typename T, typename Boundary = Closed>
+class BasicIntervalIngestor {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+    typedef BasicCoverageIndex<T, Boundary> IndexType;
+
+    explicit BasicIntervalIngestor(size_t ringCapacity = 1 << 16, size_t batchSize = 4096)
+        : _ring(ringCapacity), _batchSize(std::max<size_t>(batchSize, 1)),
+          _live(std::make_shared<const IndexType>()), _builder([this]() { Build(); }) {}
+
+    ~BasicIntervalIngestor() {
+        Stop();
+    }
+
+    BasicIntervalIngestor(const BasicIntervalIngestor&) = delete;
+    BasicIntervalIngestor& operator = (const BasicIntervalIngestor&) = delete;
+
+    // Returns false (and drops the Interval) if the ring is full
+    bool TryPush(const IntervalType &interval) {
+        if (_ring.TryPush(interval)) [[likely]] {
+            _pushed.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Waits for the builder to make room if the ring is full
+    // * Returns false (and drops the Interval) if the builder stops while waiting, as no room would ever be made
+    bool Push(const IntervalType &interval) {
+        if (_ring.TryPush(interval)) [[likely]] {
+            _pushed.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        _stalls.fetch_add(1, std::memory_order_relaxed);
+        while (!_ring.TryPush(interval)) {
+            if (_exited.load(std::memory_order_acquire)) {
+                _rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        _pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Waits until everything pushed before the call is merged into the live set
+    // * Returns false if the builder stopped before merging all of it (pushed after or while racing with Stop), rather
+    //   than waiting for merges that never come
+    bool Flush() {
+        const size_t pushed = _pushed.load(std::memory_order_acquire);
+        while (_merged.load(std::memory_order_acquire) < pushed) {
+            if (_exited.load(std::memory_order_acquire)) {
+                // Note: the builder's last merge happens before it exits, so this is the final count
+                return _merged.load(std::memory_order_acquire) >= pushed;
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Drains whatever is left in the ring and stops the builder, pushing afterwards has no effect on the live set
+    void Stop() {
+        if (_builder.joinable()) {
+            _stop.store(true, std::memory_order_release);
+            _builder.join();
+        }
+    }
+
+    // The current live set, stays valid (and unchanged) for as long as it's held
+    std::shared_ptr<const IndexType> Snapshot() const {
+        return _live.load(std::memory_order_acquire);
+    }
+
+    IngestStats Stats() const {
+        IngestStats stats;
+        stats.pushed = _pushed.load(std::memory_order_relaxed);
+        stats.rejected = _rejected.load(std::memory_order_relaxed);
+        stats.stalls = _stalls.load(std::memory_order_relaxed);
+        stats.batches = _batches.load(std::memory_order_relaxed);
+        stats.merged = _merged.load(std::memory_order_relaxed);
+        stats.liveIntervals = Snapshot()->Size();
+        return stats;
+    }
+
+    // The footprint of the live set (only the current one, older snapshots still held by readers aren't counted) plus
+    // the ring as auxiliary, the input being every Interval merged into the live set so far
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint = Snapshot()->Footprint();
+        footprint.auxiliary += _ring.Bytes();
+        footprint.inputCount = _merged.load(std::memory_order_relaxed);
+        return footprint;
+    }
+
+private:
+    void Build() {
+        std::vector<IntervalType> batch;
+        batch.reserve(_batchSize);
+
+        // Back off (up to ~1ms) while there is nothing to drain, so an idle ingestor doesn't burn a core
+        std::chrono::microseconds idle(0);
+
+        for (;;) {
+            const bool stopping = _stop.load(std::memory_order_acquire);
+
+            batch.clear();
+            IntervalType interval(T{}, T{});
+            while (batch.size() < _batchSize && _ring.TryPop(interval)) {
+                batch.push_back(interval);
+            }
+
+            if (batch.empty()) {
+                if (stopping) {
+                    _exited.store(true, std::memory_order_release);
+                    return;
+                }
+
+                idle = std::min(std::max(2 * idle, std::chrono::microseconds(1)), std::chrono::microseconds(1000));
+                std::this_thread::sleep_for(idle);
+                continue;
+            }
+            idle = std::chrono::microseconds(0);
+
+            MergeIntoLive(batch);
+
+            _batches.fetch_add(1, std::memory_order_relaxed);
+            _merged.fetch_add(batch.size(), std::memory_order_release);
+        }
+    }
+
+    // Publishes the union of the live set & the batch as the new live set
+    // * The live set is immutable (readers may hold it), so the union goes into a fresh buffer - but only the live
+    //   Intervals the batch touches are coalesced one by one, the stretches between them are copied over in bulk. That's
+    //   O(k log n) searches for a batch merging into k Intervals, plus the copy
+    void MergeIntoLive(std::vector<IntervalType> &batch) {
+        SortIntervals(batch);
+        const std::vector<IntervalType> mergedBatch = MergeIntervals(batch);
+
+        const std::shared_ptr<const IndexType> live = _live.load(std::memory_order_relaxed);
+        const std::vector<IntervalType> &current = live->Intervals();
+
+        std::vector<IntervalType> merged;
+        merged.reserve(current.size() + mergedBatch.size());
+
+        const auto append = [&merged](const IntervalType &next) {
+            if (merged.empty() || !Boundary::Touches(merged.back().Max(), next.Min())) {
+                merged.push_back(next);
+            }
+            else if (merged.back().Max() < next.Max()) {
+                merged.back() = IntervalType::FromOrdered(merged.back().Min(), next.Max());
+            }
+        };
+
+        // Live Intervals in [from, to), all starting before the next one of the batch: the first few may still be
+        // coalesced into the last one kept, the rest touch neither it nor each other
+        auto from = current.begin();
+        const auto copyUpTo = [&](typename std::vector<IntervalType>::const_iterator to) {
+            while (from != to && !merged.empty() && Boundary::Touches(merged.back().Max(), from->Min())) {
+                append(*from++);
+            }
+            merged.insert(merged.end(), from, to);
+            from = to;
+        };
+
+        for (const IntervalType &interval : mergedBatch) {
+            copyUpTo(std::partition_point(from, current.end(), [&interval](const IntervalType &other) {
+                return other.Min() < interval.Min();
+            }));
+            append(interval);
+        }
+        copyUpTo(current.end());
+
+        _live.store(std::make_shared<const IndexType>(IndexType::FromMerged(std::move(merged))), std::memory_order_release);
+    }
+
+    BoundedRing<IntervalType> _ring;
+    size_t _batchSize;
+
+    std::atomic<std::shared_ptr<const IndexType>> _live;
+
+    std::atomic<size_t> _pushed{0};
+    std::atomic<size_t> _rejected{0};
+    std::atomic<size_t> _stalls{0};
+    std::atomic<size_t> _batches{0};
+    std::atomic<size_t> _merged{0};
+    std::atomic<bool> _stop{false};
+    std::atomic<bool> _exited{false};
+
+    // Note: declared last, so the thread starts once everything it uses is constructed
+    std::thread _builder;
+};
+
+using IntervalIngestor = BasicIntervalIngestor<long int, Closed>;
+
+// Epoch based reclamation for the lock-free readers of the concurrent sets, shared by all of them
+// * A thread pins the current epoch (a Guard) for as long as it may hold pointers to nodes. Unlinked nodes are retired
+//   with the epoch they were unlinked in & freed once the epoch has moved on twice - by then no thread can hold them
+// * The epoch only moves on when every pinned thread has seen the current one, so a thread stalled inside a Guard
+//   holds back the freeing of whatever gets retired from then on (but nothing else)
+// * Pinning is a store to a per-thread record plus a fence, no RMW operations. Records are allocated once per thread
+//   & reused by later threads when it exits
+class EpochDomain {
+    struct Record;
+
+public:
+    class Guard {
+    public:
+        Guard() : _record(ThreadRecord()) {
+            if (_record->depth++ == 0) {
+                _record->state.store((_epoch.load(std::memory_order_seq_cst) << 1) | 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        ~Guard() {
+            if (--_record->depth == 0) {
+                _record->state.store(0, std::memory_order_release);
+            }
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator = (const Guard&) = delete;
+
+    private:
+        Record *_record;
+    };
+
+    static std::uint64_t Current() {
+        return _epoch.load(std::memory_order_seq_cst);
+    }
+
+    // Moves the epoch on if every pinned thread has seen the current one, returns the epoch after the attempt
+    static std::uint64_t TryAdvance() {
+        const std::uint64_t epoch = _epoch.load(std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (const Record *record = _records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            const std::uint64_t state = record->state.load(std::memory_order_acquire);
+            if ((state & 1) && (state >> 1) != epoch) {
+                return epoch;
+            }
+        }
+
+        std::uint64_t expected = epoch;
+        return _epoch.compare_exchange_strong(expected, epoch + 1, std::memory_order_seq_cst) ? epoch + 1 : expected;
+    }
+
+private:
+    // (epoch << 1) | 1 while the thread is pinned, 0 otherwise
+    struct alignas(64) Record {
+        std::atomic<std::uint64_t> state{0};
+        std::atomic<bool> inUse{true};
+        size_t depth = 0;
+        Record *next = nullptr;
+    };
+
+    // Gives the record back when the thread exits
+    struct RecordOwner {
+        Record *record = nullptr;
+
+        ~RecordOwner() {
+            if (record != nullptr) {
+                record->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static Record* ThreadRecord() {
+        thread_local RecordOwner owner;
+        if (owner.record != nullptr) [[likely]] {
+            return owner.record;
+        }
+
+        for (Record *record = _records.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+            bool inUse = false;
+            if (!record->inUse.load(std::memory_order_relaxed) && record->inUse.compare_exchange_strong(inUse, true)) {
+                return owner.record = record;
+            }
+        }
+
+        // Note: records are never freed, there are only ever as many as threads alive at the same time
+        Record *record = new Record();
+        record->next = _records.load(std::memory_order_relaxed);
+        while (!_records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return owner.record = record;
+    }
+
+    inline static std::atomic<std::uint64_t> _epoch{1};
+    inline static std::atomic<Record*> _records{nullptr};
+};
+
+// Merged set of Intervals for many threads inserting & querying at the same time, kept as a skip list ordered by min
+// * Every node holds one merged Interval, nodes neither overlap nor touch and a node's Interval never changes - an insert
+//   that overlaps existing nodes links a single new node spanning all of them and unlinks them (insert-and-coalesce)
+// * Writers use per-node locks (lazy skip list): they lock the predecessors & the nodes being coalesced in key order,
+//   validate nothing changed since the search and relink. Every coalesced node gets a pointer to the new node first,
+//   then the insert takes effect (linearises) at the single store that marks the new node linked - from then on all
+//   the coalesced nodes read as replaced at once, before any link is swung
+// * Readers take no locks and do no RMW operations. As the set only ever grows, any node a reader reaches is evidence
+//   of coverage - and a replaced node points at its (larger) replacement, so a reader that lands on one (or finds one
+//   next to where it stops) simply moves on to it. Readers only re-walk when they race with a coalesce of the very
+//   nodes they look at
+// * Coalesced nodes are retired & freed through the EpochDomain once no reader or writer can still be looking at them
+template <typename T, typename Boundary = Closed>
+class BasicConcurrentIntervalSet {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    BasicConcurrentIntervalSet() : _head(new Node(T{}, T{}, maxLevel)) {}
+
+    ~BasicConcurrentIntervalSet() {
+        for (Node *node = _head; node != nullptr;) {
+            Node *next = node->next[0].load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+
+        for (const auto &[node, epoch] : _retired) {
+            delete node;
+        }
+    }
+
+    BasicConcurrentIntervalSet(const BasicConcurrentIntervalSet&) = delete;
+    BasicConcurrentIntervalSet& operator = (const BasicConcurrentIntervalSet&) = delete;
+
+    void Insert(const IntervalType &interval) {
+        if (interval.IsEmpty()) {
+            return;
+        }
+
+        _inserted.fetch_add(1, std::memory_order_relaxed);
+        const int height = RandomHeight();
+        const EpochDomain::Guard guard;
+
+        for (;;) {
+            Node *preds[maxLevel];
+            Node *succs[maxLevel];
+            Find(interval.Min(), preds, succs);
+
+            T newMin = interval.Min();
+            T newMax = interval.Max();
+            std::vector<Node*> victims;
+
+            // The predecessor may reach into (or touch) the new Interval - it then gets coalesced too
+            Node *left = preds[0];
+            if (left != _head && Boundary::Touches(left->max, interval.Min())) {
+                if (interval.Max() <= left->max) {
+                    return;
+                }
+
+                newMin = left->min;
+                Find(newMin, preds, succs);
+                if (succs[0] != left) {
+                    continue;
+                }
+                victims.push_back(left);
+            }
+            else if (succs[0] != nullptr && succs[0]->min == interval.Min() && interval.Max() <= succs[0]->max) {
+                return;
+            }
+
+            for (Node *node = victims.empty() ? succs[0] : left->next[0].load(std::memory_order_acquire);
+                 node != nullptr && Boundary::Touches(newMax, node->min); node = node->next[0].load(std::memory_order_acquire)) {
+                victims.push_back(node);
+                newMax = std::max(newMax, node->max);
+            }
+
+            int levels = height;
+            for (Node *victim : victims) {
+                levels = std::max(levels, victim->height);
+            }
+
+            if (TryReplace(preds, victims, levels, height, newMin, newMax)) {
+                return;
+            }
+        }
+    }
+
+    // Returns true if every element of the interval is contained in the union of the Intervals inserted so far
+    bool Contains(const IntervalType &interval) const {
+        if (interval.IsEmpty()) {
+            return true;
+        }
+
+        const EpochDomain::Guard guard;
+        const Node *node = FindCandidate(interval.Min(), [&interval](const Node *candidate) {
+            return interval.Max() <= candidate->max;
+        });
+        return node != nullptr;
+    }
+
+    bool ContainsPoint(T point) const {
+        const EpochDomain::Guard guard;
+        const Node *node = FindCandidate(point, [point](const Node *candidate) {
+            return Boundary::Contains(candidate->min, candidate->max, point);
+        });
+        return node != nullptr;
+    }
+
+    // Copies the merged Intervals out, ordered by min
+    // * Not a snapshot - Intervals inserted while it runs may or may not be in it
+    std::vector<IntervalType> Intervals() const {
+        const EpochDomain::Guard guard;
+        std::vector<IntervalType> output;
+        for (Node *node = _head->next[0].load(std::memory_order_acquire); node != nullptr;
+             node = node->next[0].load(std::memory_order_acquire)) {
+            if (!Replaced(node)) {
+                output.emplace_back(node->min, node->max);
+            }
+        }
+        return output;
+    }
+
+    // Every node is allocated with all maxLevel links, the ones above its height are slack & so are the retired nodes
+    // waiting to be freed (the list of them auxiliary)
+    // * Not a snapshot either, like Intervals()
+    MemoryFootprint Footprint() const {
+        constexpr size_t boundsBytes = 2 * sizeof(T);
+        constexpr size_t linkBytes = sizeof(std::atomic<Node*>);
+
+        const EpochDomain::Guard guard;
+        MemoryFootprint footprint;
+        footprint.searchLayout = sizeof(Node) - boundsBytes;
+        footprint.slack = (maxLevel - _head->height) * linkBytes;
+
+        for (Node *node = _head->next[0].load(std::memory_order_acquire); node != nullptr;
+             node = node->next[0].load(std::memory_order_acquire)) {
+            if (Replaced(node)) {
+                continue;
+            }
+            footprint.boundaries += boundsBytes;
+            footprint.searchLayout += sizeof(Node) - boundsBytes - (maxLevel - node->height) * linkBytes;
+            footprint.slack += (maxLevel - node->height) * linkBytes;
+            ++footprint.mergedCount;
+        }
+
+        {
+            const std::lock_guard<std::mutex> lock(_retiredLock);
+            footprint.slack += _retired.size() * sizeof(Node);
+            footprint.Add(footprint.auxiliary, _retired);
+        }
+
+        footprint.inputCount = _inserted.load(std::memory_order_relaxed);
+        return footprint;
+    }
+
+private:
+    static constexpr int maxLevel = 24;
+
+    struct Node {
+        Node(T min, T max, int height) : min(min), max(max), height(height) {
+            for (auto &link : next) {
+                link.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        const T min;
+        const T max;
+        const int height;
+
+        std::atomic<Node*> next[maxLevel];
+        std::atomic<Node*> replacement{nullptr};
+        std::atomic<bool> linked{false};
+        std::mutex lock;
+    };
+
+    // Set on a coalesced node before the coalesce takes effect, so it only counts once its replacement is linked
+    static bool Replaced(const Node *node) {
+        const Node *replacement = node->replacement.load(std::memory_order_acquire);
+        return replacement != nullptr && replacement->linked.load(std::memory_order_acquire);
+    }
+
+    // Fills preds with the last node before key and succs with the first one at or past it, at every level
+    void Find(T key, Node **preds, Node **succs) const {
+        Node *pred = _head;
+        for (int level = maxLevel - 1; level >= 0; --level) {
+            Node *node = pred->next[level].load(std::memory_order_acquire);
+            while (node != nullptr && node->min < key) {
+                pred = node;
+                node = pred->next[level].load(std::memory_order_acquire);
+            }
+            preds[level] = pred;
+            succs[level] = node;
+        }
+    }
+
+    // Walks down to the last node starting at or before key & checks it - see the class comment for the replaced nodes
+    template <typename Covers>
+    const Node* FindCandidate(T key, Covers covers) const {
+        const Node *node = _head;
+        for (int level = maxLevel - 1; level >= 0; --level) {
+            const Node *next = node->next[level].load(std::memory_order_acquire);
+            while (next != nullptr && next->min <= key) {
+                node = next;
+                next = node->next[level].load(std::memory_order_acquire);
+            }
+        }
+
+        for (;;) {
+            if (node != _head && covers(node)) {
+                return node;
+            }
+
+            // The replacement of a replaced successor may start at or before key, reaching left of the successor
+            const Node *next = node->next[0].load(std::memory_order_acquire);
+            while (next != nullptr && Replaced(next)) {
+                next = next->replacement.load(std::memory_order_acquire);
+            }
+            if (next != nullptr && next->min <= key) {
+                node = next;
+                continue;
+            }
+
+            // Still in the set after its successor was read, so it was the last node starting at or before key at that point
+            if (node == _head || !Replaced(node)) {
+                return nullptr;
+            }
+
+            node = node->replacement.load(std::memory_order_acquire);
+        }
+    }
+
+    // Replaces victims (consecutive at level 0, possibly none) with a single node [newMin, newMax]
+    // * Returns false if anything changed since the search, the caller then searches again
+    bool TryReplace(Node **preds, const std::vector<Node*> &victims, int levels, int height, T newMin, T newMax) {
+        // Lock everything involved in key order (the head first, ties broken by address), so writers can't deadlock
+        std::vector<Node*> locked(preds, preds + levels);
+        locked.insert(locked.end(), victims.begin(), victims.end());
+        std::sort(locked.begin(), locked.end(), [this](const Node *lhs, const Node *rhs) {
+            if (lhs == _head || rhs == _head) {
+                return lhs == _head && rhs != _head;
+            }
+            return (lhs->min != rhs->min) ? lhs->min < rhs->min : std::less<const Node*>()(lhs, rhs);
+        });
+        locked.erase(std::unique(locked.begin(), locked.end()), locked.end());
+
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(locked.size());
+        for (Node *node : locked) {
+            locks.emplace_back(node->lock);
+        }
+
+        const auto isVictim = [&victims](const Node *node) {
+            return std::find(victims.begin(), victims.end(), node) != victims.end();
+        };
+
+        // Note: replacement is only ever set under the node's lock, which is held here
+        for (Node *victim : victims) {
+            if (victim->replacement.load(std::memory_order_relaxed) != nullptr) {
+                return false;
+            }
+        }
+
+        // At every level the predecessor has to be followed by the victims linked at that level and then by a node past
+        // the new Interval (not touching it) - otherwise something got inserted or coalesced in the meantime
+        Node *after[maxLevel];
+        for (int level = 0; level < levels; ++level) {
+            if (preds[level]->replacement.load(std::memory_order_relaxed) != nullptr) {
+                return false;
+            }
+
+            size_t skipped = 0;
+            Node *node = preds[level]->next[level].load(std::memory_order_acquire);
+            while (node != nullptr && isVictim(node)) {
+                node = node->next[level].load(std::memory_order_acquire);
+                ++skipped;
+            }
+
+            if (level == 0 && (skipped != victims.size() || (node != nullptr && Boundary::Touches(newMax, node->min)))) {
+                return false;
+            }
+
+            // Above level 0 there can't be anything before the node following the victims at level 0
+            if (level > 0 && node != nullptr && (after[0] == nullptr || node->min < after[0]->min)) {
+                return false;
+            }
+            after[level] = node;
+        }
+
+        Node *replacement = new Node(newMin, newMax, height);
+        for (int level = 0; level < height; ++level) {
+            replacement->next[level].store(after[level], std::memory_order_relaxed);
+        }
+
+        for (Node *victim : victims) {
+            victim->replacement.store(replacement, std::memory_order_release);
+        }
+
+        // The linearisation point - from here on every victim reads as replaced, whichever link a reader came through
+        replacement->linked.store(true, std::memory_order_release);
+
+        for (int level = 0; level < levels; ++level) {
+            preds[level]->next[level].store(level < height ? replacement : after[level], std::memory_order_release);
+        }
+
+        locks.clear();
+
+        Retire(victims);
+        return true;
+    }
+
+    // Queues the unlinked nodes for freeing, and frees the ones retired two epochs ago every so often
+    void Retire(const std::vector<Node*> &nodes) {
+        if (nodes.empty()) {
+            return;
+        }
+
+        const std::lock_guard<std::mutex> lock(_retiredLock);
+        const std::uint64_t epoch = EpochDomain::Current();
+        for (Node *node : nodes) {
+            _retired.emplace_back(node, epoch);
+        }
+
+        if (_retired.size() < _reclaimAt) {
+            return;
+        }
+
+        // Retired in epoch order, as the epoch is read under the lock
+        const std::uint64_t current = EpochDomain::TryAdvance();
+        size_t freed = 0;
+        while (freed < _retired.size() && _retired[freed].second + 2 <= current) {
+            delete _retired[freed++].first;
+        }
+        _retired.erase(_retired.begin(), _retired.begin() + static_cast<std::ptrdiff_t>(freed));
+        _reclaimAt = _retired.size() + reclaimBatch;
+    }
+
+    // Geometric distribution with p = 1/2, from a per-thread xorshift generator
+    static int RandomHeight() {
+        thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<std::uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return std::min(std::countr_zero(state | (std::uint64_t(1) << (maxLevel - 1))) + 1, maxLevel);
+    }
+
+    // Retired nodes are only looked at for freeing once this many more have piled up
+    static constexpr size_t reclaimBatch = 64;
+
+    Node *_head;
+
+    mutable std::mutex _retiredLock;
+    std::vector<std::pair<Node*, std::uint64_t>> _retired;
+    size_t _reclaimAt = reclaimBatch;
+
+    // Every insert bumps it, on its own cache line so it doesn't slow the readers of _head down
+    alignas(64) std::atomic<size_t> _inserted{0};
+};
+
+using ConcurrentIntervalSet = BasicConcurrentIntervalSet<long int, Closed>;
+
+// Concurrent merged set of closed integer Intervals, with the domain partitioned into equally wide shards
+// * Each shard holds the (clipped) parts of the Intervals that fall into it as its own sorted & merged vector, behind its
+//   own reader-writer lock - writes to different parts of the domain don't contend at all
+// * An Interval spanning several shards locks all of them in ascending order (so writers can't deadlock) and updates them
+//   together, so queries never see half of an insert. Queries lock the shards they span the same way (shared) and check
+//   each clipped part - parts ending right at a shard boundary are stitched by the check in the next shard
+template <typename T>
+class BasicShardedIntervalSet {
+    static_assert(std::is_integral_v<T>, "Sharding partitions an integer domain");
+
+public:
+    typedef BasicInterval<T, Closed> IntervalType;
+
+    // Splits [domain.Min(), domain.Max()] into shards, the first & the last shard also take anything below / above it
+    explicit BasicShardedIntervalSet(size_t shards = 64,
+                                     const IntervalType &domain = IntervalType(std::numeric_limits<T>::min(), std::numeric_limits<T>::max()))
+        : _shards(std::max<size_t>(shards, 1)), _domainMin(domain.Min()) {
+        typedef std::make_unsigned_t<T> Unsigned;
+
+        // Note: span / shards + 1 would overflow for a single shard over the whole domain
+        const Unsigned span = static_cast<Unsigned>(domain.Max()) - static_cast<Unsigned>(domain.Min());
+        _width = (_shards.size() == 1) ? std::numeric_limits<Unsigned>::max() : span / _shards.size() + 1;
+    }
+
+    void Insert(const IntervalType &interval) {
+        const size_t first = ShardOf(interval.Min());
+        const size_t last = ShardOf(interval.Max());
+
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(last - first + 1);
+        for (size_t shard = first; shard <= last; ++shard) {
+            locks.emplace_back(_shards[shard].lock);
+        }
+
+        for (size_t shard = first; shard <= last; ++shard) {
+            InsertIntoMergedIntervals(_shards[shard].intervals, Clip(interval, shard));
+        }
+        ++_shards[first].inserted;
+    }
+
+    // Returns true if every element of the interval is contained in the union of the Intervals inserted so far
+    bool Contains(const IntervalType &interval) const {
+        const size_t first = ShardOf(interval.Min());
+        const size_t last = ShardOf(interval.Max());
+
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(last - first + 1);
+        for (size_t shard = first; shard <= last; ++shard) {
+            locks.emplace_back(_shards[shard].lock);
+        }
+
+        for (size_t shard = first; shard <= last; ++shard) {
+            const IntervalType part = Clip(interval, shard);
+            const std::vector<IntervalType> &intervals = _shards[shard].intervals;
+
+            auto it = std::upper_bound(intervals.begin(), intervals.end(), part.Min(),
+                                       [](T value, const IntervalType &other) { return value < other.Min(); });
+            if (it == intervals.begin() || std::prev(it)->Max() < part.Max()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Copies the merged Intervals out, with the parts split by shard boundaries stitched back together
+    std::vector<IntervalType> Intervals() const {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(_shards.size());
+        for (const Shard &shard : _shards) {
+            locks.emplace_back(shard.lock);
+        }
+
+        std::vector<IntervalType> all;
+        for (const Shard &shard : _shards) {
+            all.insert(all.end(), shard.intervals.begin(), shard.intervals.end());
+        }
+
+        return MergeIntervals(all);
+    }
+
+    size_t ShardCount() const { return _shards.size(); }
+
+    // The shard table (locks included) is the search layout, the shards are read one at a time so this isn't a
+    // snapshot - mergedCount counts the parts split by shard boundaries separately
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.searchLayout = _shards.size() * sizeof(Shard);
+
+        for (const Shard &shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.lock);
+            footprint.Add(footprint.boundaries, shard.intervals);
+            footprint.inputCount += shard.inserted;
+            footprint.mergedCount += shard.intervals.size();
+        }
+
+        return footprint;
+    }
+
+private:
+    // Each shard on its own cache line(s), so the locks of neighbouring shards don't false-share
+    // * inserted counts the Intervals starting in the shard
+    struct alignas(64) Shard {
+        mutable std::shared_mutex lock;
+        std::vector<IntervalType> intervals;
+        size_t inserted = 0;
+    };
+
+    size_t ShardOf(T value) const {
+        typedef std::make_unsigned_t<T> Unsigned;
+
+        if (value <= _domainMin) {
+            return 0;
+        }
+
+        const Unsigned offset = static_cast<Unsigned>(value) - static_cast<Unsigned>(_domainMin);
+        return std::min(static_cast<size_t>(offset / _width), _shards.size() - 1);
+    }
+
+    IntervalType Clip(const IntervalType &interval, size_t shard) const {
+        typedef std::make_unsigned_t<T> Unsigned;
+
+        T min = interval.Min();
+        T max = interval.Max();
+
+        if (shard > 0) {
+            min = std::max(min, static_cast<T>(static_cast<Unsigned>(_domainMin) + shard * _width));
+        }
+        if (shard + 1 < _shards.size()) {
+            max = std::min(max, static_cast<T>(static_cast<Unsigned>(_domainMin) + (shard + 1) * _width - 1));
+        }
+
+        return IntervalType(min, max);
+    }
+
+    std::vector<Shard> _shards;
+    T _domainMin;
+    std::make_unsigned_t<T> _width;
+};
+
+using ShardedIntervalSet = BasicShardedIntervalSet<long int>;
+
+// Small merged set of Intervals stored inline, for one writer thread and many reader threads
+// * Readers go through a seqlock: read the sequence, search, read it again and retry if a write was in progress or
+//   happened meanwhile - no locks and no atomic RMW operations, just plain (relaxed atomic) loads
+// * The bounds are relaxed atomics so racing reads are well defined, on x86 & ARM these are ordinary loads/stores
+// * Only a single thread may ever call the modifying members (Insert, Assign, Clear)
+template <typename T, typename Boundary = Closed, size_t Capacity = 1024>
+class BasicSeqlockIntervalSet {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    BasicSeqlockIntervalSet() = default;
+
+    BasicSeqlockIntervalSet(const BasicSeqlockIntervalSet&) = delete;
+    BasicSeqlockIntervalSet& operator = (const BasicSeqlockIntervalSet&) = delete;
+
+    // Merges the Interval into the set, throws std::length_error if the merged set would outgrow the capacity
+    void Insert(const IntervalType &interval) {
+        if (interval.IsEmpty()) {
+            return;
+        }
+
+        const size_t size = _size.load(std::memory_order_relaxed);
+
+        // Same search as InsertIntoMergedIntervals, done on the inline arrays (no one else writes, so no need to retry)
+        size_t first = 0;
+        while (first < size && !Boundary::Touches(_max[first].load(std::memory_order_relaxed), interval.Min())) {
+            ++first;
+        }
+        size_t last = first;
+        while (last < size && Boundary::Touches(interval.Max(), _min[last].load(std::memory_order_relaxed))) {
+            ++last;
+        }
+
+        if (first == last && size == Capacity) {
+            ThrowOrAbort<std::length_error>("Seqlock interval set is full");
+        }
+
+        T min = interval.Min();
+        T max = interval.Max();
+        if (first != last) {
+            min = std::min(min, _min[first].load(std::memory_order_relaxed));
+            max = std::max(max, _max[last - 1].load(std::memory_order_relaxed));
+        }
+
+        BeginWrite();
+
+        // Shift the Intervals past the new one into place - left if it swallowed several, right if it's a new one
+        const size_t newSize = size - (last - first) + 1;
+        if (first + 1 < last) {
+            for (size_t from = last, to = first + 1; from < size; ++from, ++to) {
+                Store(to, _min[from].load(std::memory_order_relaxed), _max[from].load(std::memory_order_relaxed));
+            }
+        }
+        else if (first == last) {
+            for (size_t from = size; from > first; --from) {
+                Store(from, _min[from - 1].load(std::memory_order_relaxed), _max[from - 1].load(std::memory_order_relaxed));
+            }
+        }
+
+        Store(first, min, max);
+        _size.store(newSize, std::memory_order_relaxed);
+
+        EndWrite();
+        _inserted.store(_inserted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Replaces the content with the Intervals, throws std::length_error if they don't fit once merged
+    void Assign(std::vector<IntervalType> intervals) {
+        SortIntervals(intervals);
+        const std::vector<IntervalType> merged = MergeIntervals(intervals);
+
+        if (merged.size() > Capacity) {
+            ThrowOrAbort<std::length_error>("Seqlock interval set is full");
+        }
+
+        BeginWrite();
+        for (size_t i = 0; i < merged.size(); ++i) {
+            Store(i, merged[i].Min(), merged[i].Max());
+        }
+        _size.store(merged.size(), std::memory_order_relaxed);
+        EndWrite();
+        _inserted.store(intervals.size(), std::memory_order_relaxed);
+    }
+
+    void Clear() {
+        BeginWrite();
+        _size.store(0, std::memory_order_relaxed);
+        EndWrite();
+        _inserted.store(0, std::memory_order_relaxed);
+    }
+
+    // Returns true if every element of the interval is contained in the union of the Intervals in the set
+    bool Contains(const IntervalType &interval) const {
+        if (interval.IsEmpty()) {
+            return true;
+        }
+
+        return Read([this, &interval](size_t size) {
+            const size_t found = LastStartingAtOrBefore(size, interval.Min());
+            return found < size && interval.Max() <= _max[found].load(std::memory_order_relaxed);
+        });
+    }
+
+    bool ContainsPoint(T point) const {
+        return Read([this, point](size_t size) {
+            const size_t found = LastStartingAtOrBefore(size, point);
+            return found < size && Boundary::Contains(_min[found].load(std::memory_order_relaxed),
+                                                      _max[found].load(std::memory_order_relaxed), point);
+        });
+    }
+
+    // Copies the Intervals out, consistent with a single point in time
+    std::vector<IntervalType> Intervals() const {
+        std::vector<IntervalType> output;
+        Read([this, &output](size_t size) {
+            output.clear();
+            for (size_t i = 0; i < size; ++i) {
+                output.emplace_back(_min[i].load(std::memory_order_relaxed), _max[i].load(std::memory_order_relaxed));
+            }
+            return true;
+        });
+        return output;
+    }
+
+    size_t Size() const { return _size.load(std::memory_order_acquire); }
+
+    // The bounds are stored inline, so they are counted here even though nothing is allocated - the unused part of the
+    // capacity as slack
+    MemoryFootprint Footprint() const {
+        const size_t size = Size();
+
+        MemoryFootprint footprint;
+        footprint.boundaries = size * 2 * sizeof(std::atomic<T>);
+        footprint.slack = (Capacity - size) * 2 * sizeof(std::atomic<T>);
+        footprint.inputCount = _inserted.load(std::memory_order_relaxed);
+        footprint.mergedCount = size;
+        return footprint;
+    }
+
+private:
+    // Runs the read until it completes without a write overlapping it
+    // * The size is read inside the protected section too, and clamped, as a torn read may see garbage before the retry
+    template <typename Reader>
+    bool Read(Reader reader) const {
+        for (;;) {
+            const std::uint64_t before = _sequence.load(std::memory_order_acquire);
+            if (before & 1) [[unlikely]] {
+                continue;
+            }
+
+            const bool result = reader(std::min(_size.load(std::memory_order_relaxed), Capacity));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) == before) [[likely]] {
+                return result;
+            }
+        }
+    }
+
+    // Binary search over the inline mins, returns size if there is no such Interval
+    size_t LastStartingAtOrBefore(size_t size, T value) const {
+        size_t low = 0, high = size;
+        while (low < high) {
+            const size_t middle = low + (high - low) / 2;
+            if (_min[middle].load(std::memory_order_relaxed) <= value) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        return (low == 0) ? size : low - 1;
+    }
+
+    void BeginWrite() {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndWrite() {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void Store(size_t index, T min, T max) {
+        _min[index].store(min, std::memory_order_relaxed);
+        _max[index].store(max, std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic<std::uint64_t> _sequence{0};
+    std::atomic<size_t> _size{0};
+    std::array<std::atomic<T>, Capacity> _min{};
+    std::array<std::atomic<T>, Capacity> _max{};
+
+    // Intervals inserted (or assigned) since the last Clear, only ever written by the writer
+    std::atomic<size_t> _inserted{0};
+};
+
+using SeqlockIntervalSet = BasicSeqlockIntervalSet<long int, Closed, 1024>;
+
+// What BasicCoverageIndexBuilder does with a pair whose min is above its max
+// * Swap: swap the ends, same as the Interval constructor does
+// * Reject: throw std::invalid_argument & drop the whole batch being appended
+enum class SwappedPairPolicy {
+    Swap,
+    Reject
+};
+
+// Bulk loader for BasicCoverageIndex, normalises raw {min, max} pairs (separate arrays or one interleaved buffer)
+// * The pairs are normalised in SIMD registers where AVX2 allows (8 byte signed & double domains) & stored straight into
+//   the scratch buffer the index is then built from - no Interval constructor call per pair
+// * Swapped pairs are counted (or rejected, see SwappedPairPolicy), NaN ends are always rejected
+template <typename T, typename Boundary = Closed>
+class BasicCoverageIndexBuilder {
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+    typedef BasicCoverageIndex<T, Boundary> IndexType;
+
+    explicit BasicCoverageIndexBuilder(SwappedPairPolicy policy = SwappedPairPolicy::Swap) : _policy(policy) {}
+
+    void Reserve(size_t count) {
+        if (count > _capacity) {
+            Reallocate(count);
+        }
+    }
+
+    // Appends count pairs {mins[i], maxs[i]}
+    void Append(const T *mins, const T *maxs, size_t count) {
+        T *output = Grow(count);
+        size_t swapped = 0;
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        if constexpr (sizeof(T) == 8 && (std::is_floating_point_v<T> || std::is_signed_v<T>)) {
+            for (; i + 4 <= count; i += 4) {
+                swapped += NormaliseFourSeparate(mins + i, maxs + i, output + 2 * i);
+            }
+        }
+#endif
+
+        for (; i < count; ++i) {
+            swapped += NormalisePair(mins[i], maxs[i], output + 2 * i);
+        }
+
+        Commit(swapped);
+    }
+
+    // Appends count pairs stored as {min0, max0, min1, max1, ...}
+    void AppendInterleaved(const T *pairs, size_t count) {
+        T *output = Grow(count);
+        size_t swapped = 0;
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        if constexpr (sizeof(T) == 8 && (std::is_floating_point_v<T> || std::is_signed_v<T>)) {
+            for (; i + 2 <= count; i += 2) {
+                swapped += NormaliseTwoInterleaved(pairs + 2 * i, output + 2 * i);
+            }
+        }
+#endif
+
+        for (; i < count; ++i) {
+            swapped += NormalisePair(pairs[2 * i], pairs[2 * i + 1], output + 2 * i);
+        }
+
+        Commit(swapped);
+    }
+
+    // Sorts & merges everything appended so far into an index, the builder is empty (but keeps its counters) afterwards
+    IndexType Build() {
+        std::vector<IntervalType> intervals = Intervals();
+        SortIntervals(intervals);
+        IndexType index = IndexType::FromMerged(MergeIntervals(intervals));
+        _size = 0;
+        return index;
+    }
+
+    // Build within a memory budget, see SortAndMergeWithinBudget - the builder is only emptied if the build succeeds
+    // * Note: the appended Intervals are the input, so they don't count against the budget
+    IntervalExpected<IndexType> Build(const BuildOptions &options) {
+        IntervalExpected<IndexType> index = IndexType::Build(Intervals(), options);
+        if (index) {
+            _ends.reset();
+            _size = _capacity = 0;
+        }
+        return index;
+    }
+
+    size_t Size() const { return _size; }
+    size_t SwappedPairs() const { return _swapped; }
+
+private:
+    // Makes room for count more pairs & returns where their ends go
+    // * The buffer is left uninitialised, the normalisation writes every end of it
+    T *Grow(size_t count) {
+        if (_size + count > _capacity) {
+            Reallocate(std::max(_size + count, 2 * _capacity));
+        }
+
+        _appendedFrom = _size;
+        _size += count;
+        return _ends.get() + 2 * _appendedFrom;
+    }
+
+    void Reallocate(size_t capacity) {
+        std::unique_ptr<T[]> ends = std::make_unique_for_overwrite<T[]>(2 * capacity);
+        std::copy(_ends.get(), _ends.get() + 2 * _size, ends.get());
+        _ends = std::move(ends);
+        _capacity = capacity;
+    }
+
+    // The appended pairs as Intervals, normalised already so they're taken as they are
+    std::vector<IntervalType> Intervals() const {
+        std::vector<IntervalType> intervals;
+        intervals.reserve(_size);
+        for (size_t i = 0; i < _size; ++i) {
+            intervals.push_back(IntervalType::FromOrdered(_ends[2 * i], _ends[2 * i + 1]));
+        }
+        return intervals;
+    }
+
+    void Commit(size_t swapped) {
+        if (swapped > 0 && _policy == SwappedPairPolicy::Reject) {
+            Drop();
+            ThrowOrAbort<std::invalid_argument>("Interval min is above its max");
+        }
+
+        _swapped += swapped;
+    }
+
+    // Undoes the last Grow, so a rejected batch leaves the builder as it was
+    void Drop() {
+        _size = _appendedFrom;
+    }
+
+    size_t NormalisePair(T min, T max, T *output) {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (std::isnan(min) || std::isnan(max)) [[unlikely]] {
+                Drop();
+                ThrowOrAbort<std::invalid_argument>("Interval ends can't be NaN");
+            }
+        }
+
+        const bool swapped = max < min;
+        output[0] = swapped ? max : min;
+        output[1] = swapped ? min : max;
+        return swapped;
+    }
+
+#if defined(__AVX2__)
+    // Normalises 4 pairs given as separate mins & maxes, then interleaves them into 4 {min, max} pairs
+    // * Returns the number of swapped pairs
+    size_t NormaliseFourSeparate(const T *mins, const T *maxs, T *output) {
+        if constexpr (std::is_floating_point_v<T>) {
+            const __m256d a = _mm256_loadu_pd(mins);
+            const __m256d b = _mm256_loadu_pd(maxs);
+            RejectNaN(_mm256_cmp_pd(a, b, _CMP_UNORD_Q));
+
+            // Blends rather than min / max, so the ends come out bit for bit as the scalar swap leaves them (e.g -0.0)
+            const __m256d swapped = _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+            const __m256d low = _mm256_blendv_pd(a, b, swapped);
+            const __m256d high = _mm256_blendv_pd(b, a, swapped);
+
+            // unpack gives {low0, high0, low2, high2} & {low1, high1, low3, high3}, the permutes put the halves in order
+            const __m256d even = _mm256_unpacklo_pd(low, high);
+            const __m256d odd = _mm256_unpackhi_pd(low, high);
+            _mm256_storeu_pd(output, _mm256_permute2f128_pd(even, odd, 0x20));
+            _mm256_storeu_pd(output + 4, _mm256_permute2f128_pd(even, odd, 0x31));
+
+            return std::popcount(static_cast<unsigned>(_mm256_movemask_pd(swapped)));
+        }
+        else {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mins));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(maxs));
+
+            // AVX2 has no 64 bit min / max, so both come from a single signed > & a blend
+            const __m256i swapped = _mm256_cmpgt_epi64(a, b);
+            const __m256i low = _mm256_blendv_epi8(a, b, swapped);
+            const __m256i high = _mm256_blendv_epi8(b, a, swapped);
+
+            const __m256i even = _mm256_unpacklo_epi64(low, high);
+            const __m256i odd = _mm256_unpackhi_epi64(low, high);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), _mm256_permute2x128_si256(even, odd, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + 4), _mm256_permute2x128_si256(even, odd, 0x31));
+
+            return std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(swapped))));
+        }
+    }
+
+    // Normalises 2 interleaved pairs in place within one register - each end is compared against its pair's other end
+    // * Returns the number of swapped pairs
+    size_t NormaliseTwoInterleaved(const T *pairs, T *output) {
+        if constexpr (std::is_floating_point_v<T>) {
+            const __m256d ends = _mm256_loadu_pd(pairs);
+            const __m256d others = _mm256_permute_pd(ends, 0b0101);
+            RejectNaN(_mm256_cmp_pd(ends, ends, _CMP_UNORD_Q));
+
+            // A lane holding the min is swapped if it's > the max, a lane holding the max if it's < the min
+            const __m256d above = _mm256_cmp_pd(ends, others, _CMP_GT_OQ);
+            const __m256d below = _mm256_cmp_pd(ends, others, _CMP_LT_OQ);
+            const __m256d swapped = _mm256_blend_pd(above, below, 0b1010);
+            _mm256_storeu_pd(output, _mm256_blendv_pd(ends, others, swapped));
+
+            return std::popcount(static_cast<unsigned>(_mm256_movemask_pd(above)) & 0b0101u);
+        }
+        else {
+            const __m256i ends = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pairs));
+            const __m256i others = _mm256_shuffle_epi32(ends, 0x4E);
+
+            const __m256i above = _mm256_cmpgt_epi64(ends, others);
+            const __m256i below = _mm256_cmpgt_epi64(others, ends);
+            const __m256i swapped = _mm256_blend_epi32(above, below, 0b11001100);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), _mm256_blendv_epi8(ends, others, swapped));
+
+            return std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(above))) & 0b0101u);
+        }
+    }
+
+    void RejectNaN(__m256d unordered) {
+        if (_mm256_movemask_pd(unordered) != 0) [[unlikely]] {
+            Drop();
+            ThrowOrAbort<std::invalid_argument>("Interval ends can't be NaN");
+        }
+    }
+#endif
+
+    SwappedPairPolicy _policy;
+    std::unique_ptr<T[]> _ends;     // {min, max} pairs, _size of them appended out of room for _capacity
+    size_t _size = 0;
+    size_t _capacity = 0;
+    size_t _appendedFrom = 0;
+    size_t _swapped = 0;
+};
+
+using CoverageIndexBuilder = BasicCoverageIndexBuilder<long int, Closed>;
+using RealCoverageIndexBuilder = BasicCoverageIndexBuilder<double, Closed>;
+
+// Read-only coverage index storing the merged mins frame-of-reference encoded, for twice (or four times) the SIMD lanes
+// * The mins are split into cache line sized blocks, each holding a full width base (its first min) & the other mins
+//   as 32 (or 16) bit offsets from it - a block ends early if the next min is too far from its base to fit
+// * A query binary searches the block bases, then counts the block offsets <= its own offset in one SIMD compare
+// * The maxes stay full width, only the one of the found Interval is ever read
+// * Exact, as every offset is the precise difference from its base
+template <typename T, typename Boundary = Closed, typename Offset = std::uint32_t>
+class BasicBlockCoverageIndex {
+    static_assert(std::is_integral_v<T>, "Block layout needs an integral domain");
+    static_assert(std::is_unsigned_v<Offset> && sizeof(Offset) <= 4 && sizeof(Offset) < sizeof(T),
+                  "Block offsets have to be narrower unsigned integers");
+
+public:
+    typedef BasicInterval<T, Boundary> IntervalType;
+
+    static constexpr size_t blockSize = 64 / sizeof(Offset);
+
+    explicit BasicBlockCoverageIndex(const BasicCoverageIndex<T, Boundary> &index) : _inputCount(index.InputCount()) {
+        Build(index.Intervals());
+    }
+
+    explicit BasicBlockCoverageIndex(const std::vector<IntervalType> &intervals)
+        : BasicBlockCoverageIndex(BasicCoverageIndex<T, Boundary>(intervals)) {}
+
+    bool Contains(const IntervalType &interval) const {
+        if (interval.IsEmpty()) {
+            return true;
+        }
+
+        T min;
+        const size_t found = FindLastStartingAtOrBefore(interval.Min(), min);
+        return found < _maxes.size() && interval.Max() <= _maxes[found];
+    }
+
+    bool ContainsPoint(T point) const {
+        T min;
+        const size_t found = FindLastStartingAtOrBefore(point, min);
+        return found < _maxes.size() && Boundary::Contains(min, _maxes[found], point);
+    }
+
+    size_t Size() const { return _maxes.size(); }
+    size_t BlockCount() const { return _bases.size(); }
+
+    // The offsets & maxes are the boundaries, the block bases & first indexes the search layout - offset slots left
+    // unused by blocks closed early are slack
+    MemoryFootprint Footprint() const {
+        MemoryFootprint footprint;
+        footprint.Add(footprint.boundaries, _blocks);
+        footprint.Add(footprint.boundaries, _maxes);
+        footprint.Add(footprint.searchLayout, _bases);
+        footprint.Add(footprint.searchLayout, _firsts);
+
+        const size_t unusedOffsets = (_blocks.size() * blockSize - _maxes.size()) * sizeof(Offset);
+        footprint.boundaries -= unusedOffsets;
+        footprint.slack += unusedOffsets;
+
+        footprint.inputCount = _inputCount;
+        footprint.mergedCount = _maxes.size();
+        return footprint;
+    }
+
+private:
+    typedef std::make_unsigned_t<T> Unsigned;
+
+    struct alignas(64) Block {
+        Offset offsets[blockSize];
+    };
+
+    void Build(const std::vector<IntervalType> &merged) {
+        _maxes.reserve(merged.size());
+
+        for (size_t i = 0; i < merged.size(); ++i) {
+            const size_t filled = i - (_firsts.empty() ? 0 : _firsts.back());
+            const bool fits = !_bases.empty() && filled < blockSize &&
+                              Unsigned(merged[i].Min()) - Unsigned(_bases.back()) <= std::numeric_limits<Offset>::max();
+
+            if (!fits) {
+                _bases.push_back(merged[i].Min());
+                _firsts.push_back(i);
+                _blocks.emplace_back();
+                std::fill(std::begin(_blocks.back().offsets), std::end(_blocks.back().offsets),
+                          std::numeric_limits<Offset>::max());
+            }
+
+            _blocks.back().offsets[i - _firsts.back()] = Offset(Unsigned(merged[i].Min()) - Unsigned(_bases.back()));
+            _maxes.push_back(merged[i].Max());
+        }
+
+        // Sentinel, so the length of block b is always _firsts[b + 1] - _firsts[b]
+        _firsts.push_back(merged.size());
+    }
+
+    // Index of the last Interval starting at or before value (its min decoded into min), or Size() if there is none
+    size_t FindLastStartingAtOrBefore(T value, T &min) const {
+        const auto it = std::upper_bound(_bases.begin(), _bases.end(), value);
+        if (it == _bases.begin()) {
+            return _maxes.size();
+        }
+
+        const size_t block = (it - _bases.begin()) - 1;
+        const size_t first = _firsts[block];
+        const size_t length = _firsts[block + 1] - first;
+        const Unsigned delta = Unsigned(value) - Unsigned(_bases[block]);
+
+        // Past the reach of the offsets, so past every min in the block, otherwise count the mins at or before value
+        // * The first offset is always 0 <= delta, so at least one is counted
+        const size_t inBlock = (delta > std::numeric_limits<Offset>::max())
+                             ? length - 1 : CountAtOrBelow(_blocks[block], Offset(delta), length) - 1;
+
+        min = T(Unsigned(_bases[block]) + _blocks[block].offsets[inBlock]);
+        return first + inBlock;
+    }
+
+    static size_t CountAtOrBelow(const Block &block, Offset delta, size_t length) {
+#if defined(__AVX2__)
+        // AVX2 only compares signed lanes, flipping the top bit of both sides makes that an unsigned compare
+        // * The padding past length is masked out of the movemask rather than relied on
+        const std::uint64_t lanes = (length == blockSize) ? ~std::uint64_t(0)
+                                                          : (std::uint64_t(1) << (length * sizeof(Offset))) - 1;
+        std::uint64_t above = 0;
+
+        for (size_t half = 0; half < 2; ++half) {
+            const __m256i offsets = _mm256_load_si256(reinterpret_cast<const __m256i *>(block.offsets) + half);
+            __m256i greater;
+            if constexpr (sizeof(Offset) == 4) {
+                const __m256i flip = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+                greater = _mm256_cmpgt_epi32(_mm256_xor_si256(offsets, flip),
+                                             _mm256_xor_si256(_mm256_set1_epi32(std::int32_t(delta)), flip));
+            }
+            else if constexpr (sizeof(Offset) == 2) {
+                const __m256i flip = _mm256_set1_epi16(std::numeric_limits<std::int16_t>::min());
+                greater = _mm256_cmpgt_epi16(_mm256_xor_si256(offsets, flip),
+                                             _mm256_xor_si256(_mm256_set1_epi16(std::int16_t(delta)), flip));
+            }
+            else {
+                greater = _mm256_cmpgt_epi8(_mm256_xor_si256(offsets, _mm256_set1_epi8(-128)),
+                                            _mm256_xor_si256(_mm256_set1_epi8(std::int8_t(delta)), _mm256_set1_epi8(-128)));
+            }
+            above |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(greater))) << (32 * half);
+        }
+
+        return length - std::popcount(above & lanes) / sizeof(Offset);
+#else
+        size_t count = 0;
+        for (size_t i = 0; i < length; ++i) {
+            count += (block.offsets[i] <= delta);
+        }
+        return count;
+#endif
+    }
+
+    std::vector<T> _bases;
+    std::vector<size_t> _firsts;
+    std::vector<Block> _blocks;
+    std::vector<T> _maxes;
+    size_t _inputCount = 0;
+};
+
+using BlockCoverageIndex = BasicBlockCoverageIndex<long int, Closed, std::uint32_t>;
+
+// Merges the Intervals of two runs sorted by min into output, coalescing them on the way (same rules as MergeIntervals)
+// * One pass, no std::merge into a temporary first
+template <typename T, typename Boundary>
+void MergeSortedRuns(const BasicInterval<T, Boundary> *a, const BasicInterval<T, Boundary> *aLast,
+                     const BasicInterval<T, Boundary> *b, const BasicInterval<T, Boundary> *bLast,
+                     std::vector<BasicInterval<T, Boundary>> &output) {
+    while (a != aLast || b != bLast) {
+        // Ties go to a, so the order matches std::merge
+        const BasicInterval<T, Boundary> &next = (b == bLast || (a != aLast && !(b->Min() < a->Min()))) ? *a++ : *b++;
+
+        if (next.IsEmpty()) {
+            continue;
+        }
+
+        if (output.empty() || !Boundary::Touches(output.back().Max(), next.Min())) {
+            output.push_back(next);
+        }
+        else if (output.back().Max() < next.Max()) {
+            // Can't fail, the new max is above the old one - so the checks of SetMax are skipped
+            output.back() = BasicInterval<T, Boundary>::FromOrdered(output.back().Min(), next.Max());
+        }
+    }
+}
+
+// Concatenates the parts (skipping the first skip[i] Intervals of part i) into one vector, the copying split between threads
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> JoinIntervalParts(const std::vector<std::vector<BasicInterval<T, Boundary>>> &parts,
+                                                          const std::vector<size_t> &skip) {
+    std::vector<size_t> offsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i) {
+        offsets[i + 1] = offsets[i] + (parts[i].size() - skip[i]);
+    }
+
+    std::vector<BasicInterval<T, Boundary>> output(offsets.back(), BasicInterval<T, Boundary>::FromOrdered(T{}, T{}));
+    std::vector<std::future<void>> running;
+
+    for (size_t i = 0; i < parts.size(); ++i) {
+        running.push_back(std::async(i == 0 ? std::launch::deferred : std::launch::async, [&, i]() {
+            std::copy(parts[i].begin() + skip[i], parts[i].end(), output.begin() + offsets[i]);
+        }));
+    }
+
+    for (std::future<void> &result : running) {
+        result.get();
+    }
+
+    return output;
+}
+
+// Union of two sorted & merged sets of Intervals, the result sorted & merged as well
+// * Merge path partitioning: the merged order of both inputs is cut into equal segments (one per thread), each cut
+//   found by a binary search along its diagonal, so every thread gets the same amount of work however the two interleave
+// * Each segment is merged independently, then the Intervals straddling the cuts are coalesced (one short sequential
+//   pass over the segment ends) & the segments copied into place in parallel
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> UnionOfMergedIntervals(const std::vector<BasicInterval<T, Boundary>> &a,
+                                                               const std::vector<BasicInterval<T, Boundary>> &b,
+                                                               unsigned threads = std::thread::hardware_concurrency()) {
+    const size_t total = a.size() + b.size();
+
+    // Note: not worth a thread below ~64K Intervals
+    const size_t segments = std::clamp<size_t>(total / 65536, 1, std::max(threads, 1u));
+
+    // cuts[i] is how many of a come before diagonal i * total / segments in the merged order
+    std::vector<size_t> cuts(segments + 1);
+    for (size_t i = 0; i <= segments; ++i) {
+        const size_t diagonal = i * total / segments;
+        size_t low = (diagonal > b.size()) ? diagonal - b.size() : 0;
+        size_t high = std::min(diagonal, a.size());
+
+        while (low < high) {
+            const size_t middle = low + (high - low) / 2;
+            if (!(b[diagonal - middle - 1].Min() < a[middle].Min())) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        cuts[i] = low;
+    }
+
+    std::vector<std::vector<BasicInterval<T, Boundary>>> parts(segments);
+    std::vector<std::future<void>> running;
+
+    for (size_t i = 0; i < segments; ++i) {
+        running.push_back(std::async(i == 0 ? std::launch::deferred : std::launch::async, [&, i]() {
+            const size_t aFrom = cuts[i], aTo = cuts[i + 1];
+            const size_t bFrom = i * total / segments - aFrom, bTo = (i + 1) * total / segments - aTo;
+
+            parts[i].reserve((aTo - aFrom) + (bTo - bFrom));
+            MergeSortedRuns(a.data() + aFrom, a.data() + aTo, b.data() + bFrom, b.data() + bTo, parts[i]);
+        }));
+    }
+
+    for (std::future<void> &result : running) {
+        result.get();
+    }
+
+    // Fix up the cuts: the first Intervals of a segment may touch the last one kept so far (possibly from an earlier
+    // segment, if a long Interval swallowed whole segments), those get coalesced into it & skipped when joining
+    std::vector<size_t> skip(segments, 0);
+    bool hasLast = false;
+    size_t lastPart = 0;
+    T lastMax{};
+
+    for (size_t i = 0; i < segments; ++i) {
+        size_t &skipped = skip[i];
+        if (hasLast) {
+            while (skipped < parts[i].size() && Boundary::Touches(lastMax, parts[i][skipped].Min())) {
+                lastMax = std::max(lastMax, parts[i][skipped].Max());
+                ++skipped;
+            }
+        }
+
+        if (skipped < parts[i].size()) {
+            if (hasLast && parts[lastPart].back().Max() < lastMax) {
+                parts[lastPart].back() = BasicInterval<T, Boundary>::FromOrdered(parts[lastPart].back().Min(), lastMax);
+            }
+
+            hasLast = true;
+            lastPart = i;
+            lastMax = parts[i].back().Max();
+        }
+    }
+
+    if (hasLast && parts[lastPart].back().Max() < lastMax) {
+        parts[lastPart].back() = BasicInterval<T, Boundary>::FromOrdered(parts[lastPart].back().Min(), lastMax);
+    }
+
+    return JoinIntervalParts(parts, skip);
+}
+
+// Intersection of two sorted & merged sets of Intervals, the result sorted & merged as well
+// * a is split into equal segments, one per thread, each finding where its partners in b start with a binary search
+//   (the maxes of merged Intervals are sorted too), then walking both with two pointers
+// * Pieces of the result lie within a single Interval of a & of b, so they never touch across a cut - no fix up needed
+template <typename T, typename Boundary>
+std::vector<BasicInterval<T, Boundary>> IntersectionOfMergedIntervals(const std::vector<BasicInterval<T, Boundary>> &a,
+                                                                      const std::vector<BasicInterval<T, Boundary>> &b,
+                                                                      unsigned threads = std::thread::hardware_concurrency()) {
+    // Note: not worth a thread below ~64K Intervals
+    const size_t segments = std::clamp<size_t>((a.size() + b.size()) / 65536, 1, std::max(threads, 1u));
+
+    std::vector<std::vector<BasicInterval<T, Boundary>>> parts(segments);
+    std::vector<std::future<void>> running;
+
+    for (size_t i = 0; i < segments; ++i) {
+        running.push_back(std::async(i == 0 ? std::launch::deferred : std::launch::async, [&, i]() {
+            size_t aIndex = i * a.size() / segments;
+            const size_t aTo = (i + 1) * a.size() / segments;
+            if (aIndex == aTo) {
+                return;
+            }
+
+            // First Interval of b not ending before this segment's first Interval of a starts
+            size_t bIndex = std::partition_point(b.begin(), b.end(), [&](const BasicInterval<T, Boundary> &interval) {
+                return interval.Max() < a[aIndex].Min();
+            }) - b.begin();
+
+            while (aIndex < aTo && bIndex < b.size()) {
+                const T min = std::max(a[aIndex].Min(), b[bIndex].Min());
+                const T max = std::min(a[aIndex].Max(), b[bIndex].Max());
+
+                // Note: checked before constructing, as the constructor would swap reversed ends rather than reject them
+                if (min <= max && !Boundary::IsEmpty(min, max)) {
+                    parts[i].emplace_back(min, max);
+                }
+
+                if (a[aIndex].Max() < b[bIndex].Max()) {
+                    ++aIndex;
+                }
+                else {
+                    ++bIndex;
+                }
+            }
+        }));
+    }
+
+    for (std::future<void> &result : running) {
+        result.get();
+    }
+
+    return JoinIntervalParts(parts, std::vector<size_t>(segments, 0));
 }
@@ -0,0 +1,312 @@
+// Searches for the Interval collections (and queries) costing MergeIntervals or the coverage query the most per call,
+// to catch inputs that blow up branch mispredictions or cache misses before they show up in production
+// * Hill climbing over a small population: every round mutates a copy of a random member, measures it & keeps it if
+//   it beats the cheapest member - the objective is CPU cycles per call from perf_event_open, or nanoseconds from the
+//   steady clock where perf counters aren't available (e.g containers, VMs without a PMU)
+// * The worst inputs found are saved to the corpus directory as query traces (see BasicQueryTraceRecorder), which
+//   benchmark.cxx replays like any other trace
+// * Build with e.g: g++ -std=c++20 -O2 -mavx2 -pthread perf_fuzzer.cxx -o perf_fuzzer
+//
+// Usage: perf_fuzzer [--target merge|query] [--size <n>] [--queries <n>] [--iterations <n>] [--keep <n>]
+//                    [--corpus <directory>] [--seed <n>]
+
+#include "intervals.cxx"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// CPU cycles spent in user space by this thread, falls back to steady clock nanoseconds if the counter can't be opened
+class CycleCounter {
+public:
+    CycleCounter() {
+#if defined(__linux__)
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        _descriptor = static_cast<int>(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CycleCounter() {
+#if defined(__linux__)
+        if (_descriptor >= 0) {
+            close(_descriptor);
+        }
+#endif
+    }
+
+    CycleCounter(const CycleCounter&) = delete;
+    CycleCounter& operator = (const CycleCounter&) = delete;
+
+    bool HasCycles() const { return _descriptor >= 0; }
+    const char* Unit() const { return HasCycles() ? "cycles" : "ns"; }
+
+    template <typename Work>
+    double Count(Work work) {
+#if defined(__linux__)
+        if (_descriptor >= 0) {
+            ioctl(_descriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(_descriptor, PERF_EVENT_IOC_ENABLE, 0);
+            work();
+            ioctl(_descriptor, PERF_EVENT_IOC_DISABLE, 0);
+
+            std::uint64_t cycles = 0;
+            if (read(_descriptor, &cycles, sizeof(cycles)) == static_cast<ssize_t>(sizeof(cycles))) {
+                return static_cast<double>(cycles);
+            }
+        }
+#endif
+        const Clock::time_point start = Clock::now();
+        work();
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+private:
+    int _descriptor = -1;
+};
+
+struct Candidate {
+    std::vector<Interval> intervals;
+    std::vector<Interval> queries;
+    double cost = 0.0;
+};
+
+enum class Target {
+    Merge,
+    Query
+};
+
+// Cost per call of the target on the candidate, the least of a few runs to filter out interruptions
+double Measure(CycleCounter &counter, Target target, const Candidate &candidate) {
+    double best = std::numeric_limits<double>::max();
+    size_t sink = 0;
+
+    if (target == Target::Merge) {
+        // MergeIntervals expects sorted input, the sort itself isn't what's being measured
+        std::vector<Interval> sorted(candidate.intervals);
+        std::sort(sorted.begin(), sorted.end());
+
+        for (int run = 0; run < 5; ++run) {
+            best = std::min(best, counter.Count([&]() { sink += MergeIntervals(sorted).size(); }));
+        }
+    }
+    else {
+        const CoverageIndex index(candidate.intervals);
+        for (int run = 0; run < 5; ++run) {
+            best = std::min(best, counter.Count([&]() {
+                for (const Interval &query : candidate.queries) {
+                    sink += index.Contains(query);
+                }
+            }) / static_cast<double>(std::max<size_t>(candidate.queries.size(), 1)));
+        }
+    }
+
+    // Keeps the work from being optimised away
+    if (sink == std::numeric_limits<size_t>::max()) {
+        std::printf("?");
+    }
+
+    return best;
+}
+
+long int RandomValue(std::mt19937_64 &random, long int range) {
+    return static_cast<long int>(random() % static_cast<unsigned long>(range)) - range / 2;
+}
+
+// value + step (step >= 0), stuck at the top of the domain rather than overflowing - the extreme values mutation
+// leaves Intervals ending right there for the others to build on
+long int SaturatingAdd(long int value, long int step) {
+    return (value > std::numeric_limits<long int>::max() - step) ? std::numeric_limits<long int>::max() : value + step;
+}
+
+Interval RandomInterval(std::mt19937_64 &random, long int range) {
+    const long int min = RandomValue(random, range);
+    return Interval(min, min + static_cast<long int>(random() % 64));
+}
+
+// One random mutation, each aimed at a known way of making the code under test slower
+void Mutate(std::mt19937_64 &random, std::vector<Interval> &intervals, long int range) {
+    if (intervals.empty()) {
+        return;
+    }
+
+    const size_t size = intervals.size();
+    const size_t at = random() % size;
+    const size_t span = 1 + random() % std::min<size_t>(size - at, 64);
+
+    switch (random() % 7) {
+    case 0:
+        // Plain replacement
+        intervals[at] = RandomInterval(random, range);
+        break;
+    case 1:
+        // Alternate touching & gapped neighbours - the merge branch flips every Interval
+        for (size_t i = at + 1; i < at + span; ++i) {
+            const long int gap = ((i - at) % 2) ? 1 : 2 + static_cast<long int>(random() % 3);
+            const long int min = SaturatingAdd(intervals[i - 1].Max(), gap);
+            intervals[i] = Interval(min, SaturatingAdd(min, static_cast<long int>(random() % 8)));
+        }
+        break;
+    case 2:
+        // Random gaps - an unpredictable merge branch
+        for (size_t i = at + 1; i < at + span; ++i) {
+            const long int min = SaturatingAdd(intervals[i - 1].Max(), static_cast<long int>(random() % 3));
+            intervals[i] = Interval(min, SaturatingAdd(min, static_cast<long int>(random() % 4)));
+        }
+        break;
+    case 3:
+        // Nest Intervals inside the previous one - merges that don't extend the max
+        for (size_t i = at + 1; i < at + span; ++i) {
+            const long int min = SaturatingAdd(intervals[at].Min(), static_cast<long int>(random() % 16));
+            intervals[i] = Interval(min, SaturatingAdd(min, static_cast<long int>(random() % 16)));
+        }
+        break;
+    case 4:
+        // Spread Intervals across the whole domain - no locality left for the searches
+        for (size_t i = at; i < at + span; ++i) {
+            intervals[i] = RandomInterval(random, std::numeric_limits<long int>::max() / 2);
+        }
+        break;
+    case 5:
+        // Duplicates of one Interval
+        for (size_t i = at + 1; i < at + span; ++i) {
+            intervals[i] = intervals[at];
+        }
+        break;
+    default:
+        // Extreme values at the ends of the domain
+        intervals[at] = (random() % 2) ? Interval(std::numeric_limits<long int>::min(), RandomValue(random, range))
+                                       : Interval(RandomValue(random, range), std::numeric_limits<long int>::max());
+        break;
+    }
+}
+
+// Saves the candidate as a query trace: a build of its Intervals, then its queries
+void SaveTrace(const std::string &path, const Candidate &candidate) {
+    QueryTraceRecorder recorder(path);
+    QueryTraceRecorder::Install(&recorder);
+
+    const CoverageIndex index(candidate.intervals);
+    for (const Interval &query : candidate.queries) {
+        index.Contains(query);
+    }
+
+    QueryTraceRecorder::Install(nullptr);
+}
+
+}
+
+int main(int argc, char **argv) {
+    Target target = Target::Query;
+    size_t size = 4096;
+    size_t queryCount = 1024;
+    size_t iterations = 2000;
+    size_t keep = 8;
+    std::string corpus = "perf_corpus";
+    std::uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        const std::string value = argv[i + 1];
+
+        if (option == "--target" && (value == "merge" || value == "query")) {
+            target = (value == "merge") ? Target::Merge : Target::Query;
+        }
+        else if (option == "--size") {
+            size = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (option == "--queries") {
+            queryCount = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (option == "--iterations") {
+            iterations = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (option == "--keep") {
+            keep = std::max<size_t>(std::strtoull(value.c_str(), nullptr, 10), 1);
+        }
+        else if (option == "--corpus") {
+            corpus = value;
+        }
+        else if (option == "--seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        }
+        else {
+            std::fprintf(stderr, "Unknown option %s %s\n", option.c_str(), value.c_str());
+            return 2;
+        }
+    }
+
+    std::mt19937_64 random(seed);
+    CycleCounter counter;
+    const long int range = static_cast<long int>(std::max<size_t>(size, 1)) * 64;
+    const char *targetName = (target == Target::Merge) ? "merge" : "query";
+
+    std::printf("Fuzzing %s over %zu Intervals, objective: %s per call\n", targetName, size, counter.Unit());
+
+    // Start from plain random collections, queries stay random over the same range & only the collection is mutated
+    std::vector<Candidate> population(keep);
+    for (Candidate &candidate : population) {
+        for (size_t i = 0; i < size; ++i) {
+            candidate.intervals.push_back(RandomInterval(random, range));
+        }
+        for (size_t i = 0; i < queryCount; ++i) {
+            candidate.queries.push_back(RandomInterval(random, range));
+        }
+        candidate.cost = Measure(counter, target, candidate);
+    }
+    const double initial = std::max_element(population.begin(), population.end(), [](const Candidate &lhs, const Candidate &rhs) {
+        return lhs.cost < rhs.cost;
+    })->cost;
+
+    for (size_t iteration = 0; iteration < iterations; ++iteration) {
+        Candidate child = population[random() % population.size()];
+        for (size_t mutations = 1 + random() % 4; mutations > 0; --mutations) {
+            Mutate(random, child.intervals, range);
+        }
+        child.cost = Measure(counter, target, child);
+
+        auto cheapest = std::min_element(population.begin(), population.end(), [](const Candidate &lhs, const Candidate &rhs) {
+            return lhs.cost < rhs.cost;
+        });
+        if (child.cost > cheapest->cost) {
+            *cheapest = std::move(child);
+        }
+    }
+
+    std::sort(population.begin(), population.end(), [](const Candidate &lhs, const Candidate &rhs) {
+        return lhs.cost > rhs.cost;
+    });
+
+    std::error_code error;
+    std::filesystem::create_directories(corpus, error);
+    if (error) {
+        std::fprintf(stderr, "Can't create corpus directory %s: %s\n", corpus.c_str(), error.message().c_str());
+        return 1;
+    }
+
+    std::printf("Worst random start: %.1f %s per call\n", initial, counter.Unit());
+    for (size_t rank = 0; rank < population.size(); ++rank) {
+        const std::string path = corpus + "/worst-" + targetName + "-" + std::to_string(seed) + "-" + std::to_string(rank) + ".trace";
+        SaveTrace(path, population[rank]);
+        std::printf("%.1f %s per call -> %s\n", population[rank].cost, counter.Unit(), path.c_str());
+    }
+
+    return 0;
+}